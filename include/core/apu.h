@@ -97,7 +97,7 @@ int16_t sample_right_channel(APU *apu);
 
 void div_apu_event(APU *apu);
 
-void apu_dot(APU *apu);
+void apu_advance(APU *apu, uint32_t dots);
 
 void write_audio_register(APU *apu, uint16_t address, uint8_t value);
 
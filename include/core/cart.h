@@ -7,9 +7,16 @@
 #define SAVE_DIR    "saves"
 #define MAX_FILE_PATH  256
 
+#define RTC_FREQUENCY 32768
+#define RTC_TICK_DOTS   128 // System clock dots per oscillator tick.
+
 #define DEFAULT_RAM_BANK 0
 #define DEFAULT_ROM_BANK 1
 
+typedef struct RomImage     RomImage;
+typedef struct SaveWriter SaveWriter;
+typedef struct GbcEmu         GbcEmu;
+
 typedef enum
 {
     TITLE_ADDRESS             = (uint16_t) 0x0134,
@@ -104,6 +111,9 @@ typedef struct
 
     uint8_t prev_latch_value;
 
+    uint16_t divider; // Oscillator ticks into the current second.
+    int64_t saved_at; // Host time of the last save, 0 when unknown.
+
 } RTCC; // Real-Time Cartridge-Clock
 
 typedef struct Cartridge
@@ -121,6 +131,12 @@ typedef struct Cartridge
     uint8_t           lower;
     uint8_t           upper;
     uint8_t      mbc5_upper;
+    uint16_t      rom0_bank; // Physical bank mapped at $0000 - $3FFF.
+    uint16_t      romx_bank; // Physical bank mapped at $4000 - $7FFF.
+    uint8_t      *rom0_base; // Bank memory behind $0000 - $3FFF.
+    uint8_t      *romx_base; // Bank memory behind $4000 - $7FFF.
+    uint8_t       *ram_base; // Bank memory behind $A000 - $BFFF, NULL when not plain RAM.
+    uint64_t      rtc_cycle; // Dot count the clock was last advanced to.
 
     // 'Immutable' State
     uint8_t  ram_bank_quantity;
@@ -130,11 +146,15 @@ typedef struct Cartridge
 
     // Accessories
     RTCC    clock;
+    const uint64_t *cycle; // Scheduler dot counter.
     Header header;
     
     // Memory
-    uint8_t *rom;
+    RomImage *image; // Shared, read-only.
+    uint8_t     *rom;
     uint8_t *ram;
+    uint32_t *dirty_pages; // One bit per SAVE_PAGE_SIZE bytes of RAM, cleared by snapshots.
+    SaveWriter     *saver;
     
     // Meta Data
     char *file_path;
@@ -151,15 +171,15 @@ Cartridge *init_cartridge(const char *file_path, const char *file_name);
 
 uint8_t read_cartridge(Cartridge *cart, uint16_t address);
 
-void rtc_tick_day(Cartridge *cart);
+void link_cartridge(Cartridge *cart, GbcEmu *emu);
 
-void rtc_tick_hour(Cartridge *cart);
+void rtc_advance(Cartridge *cart, uint64_t seconds);
 
-void rtc_tick_minute(Cartridge *cart);
+void save_cartridge(Cartridge *cart);
 
-void rtc_tick_second(Cartridge *cart);
+bool snapshot_cartridge_save(Cartridge *cart, bool force);
 
-void save_cartridge(Cartridge *cart);
+bool flush_cartridge_save(Cartridge *cart);
 
 void tidy_cartridge(Cartridge **cart);
 
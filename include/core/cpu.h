@@ -3,12 +3,43 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stdatomic.h>
 
 typedef struct Cartridge Cartridge;
 typedef struct EmuMemory EmuMemory;
 typedef struct EmuTimer EmuTimer;
 typedef struct GbcEmu GbcEmu;
 typedef struct CPU CPU;
+typedef struct Scheduler Scheduler;
+typedef struct TraceBuffer TraceBuffer;
+typedef struct Profiler Profiler;
+
+#define BLOCK_CACHE_SIZE 1024
+#define MAX_BLOCK_LENGTH   16
+
+#define MAX_SPIN_BYTES     16
+#define MAX_SPIN_CYCLES    32
+
+#define MAX_RUN_CYCLES    249 // Chained instructions, the longest one still fits idle_cycles.
+
+#ifndef BLOCK_EXEC_SUPPORT
+#define BLOCK_EXEC_SUPPORT  1 // Block interpreter, build with -DBLOCK_EXEC_SUPPORT=0 to compile it out.
+#endif
+
+#ifndef THREADED_DISPATCH
+#ifdef __GNUC__
+#define THREADED_DISPATCH   1 // Computed-goto dispatch, -DTHREADED_DISPATCH=0 for function pointers.
+#else
+#define THREADED_DISPATCH   0
+#endif
+#endif
+
+#ifndef TRACE_SUPPORT
+#define TRACE_SUPPORT       1 // Build with -DTRACE_SUPPORT=0 to compile the execution tracer out.
+#endif
+
+#define PREFIX_SLOT       256 // Dispatch slot offset of CB-prefixed opcodes.
+#define INTERRUPT_SLOT    512 // Dispatch slot of the interrupt routine.
 
 typedef enum
 {
@@ -29,6 +60,16 @@ typedef enum
       
 } Flag;
 
+typedef enum
+{
+    FLAGS_RESOLVED, // F holds the current flags.
+    ADD_FLAGS,      // ADD, ADC
+    SUB_FLAGS,      // SUB, SBC, CP
+    INC_FLAGS,      // INC r8, C carried through.
+    DEC_FLAGS       // DEC r8, C carried through.
+
+} FlagOp;
+
 typedef enum
 {
     VBLANK_INTERRUPT_CODE   = 0x01,
@@ -49,6 +90,29 @@ typedef enum
 
 } DualRegister;
 
+typedef enum
+{
+    CYCLE_EXEC       = 0, // One micro-step per machine cycle.
+    INSTRUCTION_EXEC = 1  // Whole instructions, peripherals catch up afterwards.
+
+} ExecMode;
+
+/*
+    Mode changes are posted from the frontend thread and picked up by
+    machine_cycle, since leaving an idle loop rewrites the CPU state the
+    emulation thread is working on. The low bits hold the requested modes
+    and stay set once applied. The tracer is attached the same way so the
+    emulation thread never sees it vanish halfway through a record.
+*/
+typedef enum
+{
+    MODE_REQUEST_BLOCK       = 0x01, // Block execution on.
+    MODE_REQUEST_INSTRUCTION = 0x02, // INSTRUCTION_EXEC rather than CYCLE_EXEC.
+    MODE_REQUEST_TRACE       = 0x04, // Tracer attached, buffer in trace_request.
+    MODE_REQUEST_PENDING     = 0x80  // Not yet applied.
+
+} ModeRequest;
+
 typedef enum
 {
     RISING  = 0, 
@@ -78,6 +142,40 @@ typedef struct
 
 } Register;
 
+typedef struct
+{
+    FlagOp      op; // Last flag-setting operation not yet folded into F.
+    uint8_t    lhs;
+    uint8_t    rhs;
+    uint8_t  carry; // Carry-in for ADC/SBC, preserved C for INC/DEC.
+    uint8_t result;
+
+} LazyFlags;
+
+typedef struct
+{
+    uint16_t  address;
+    uint8_t    opcode;
+    uint8_t    length;
+    uint8_t  bytes[3]; // Opcode followed by its operands.
+    bool  cb_prefixed;
+
+    bool (*handler)(CPU*);
+
+} DecodedInstruction;
+
+typedef struct
+{
+    bool                          valid;
+    uint16_t                      start;
+    uint16_t                       bank;
+    const uint16_t           *live_bank; // Cartridge bank register, NULL for RAM code.
+    uint8_t                       count;
+    uint8_t              register_count; // Leading instructions that never touch the bus.
+    DecodedInstruction ins[MAX_BLOCK_LENGTH];
+
+} CodeBlock;
+
 typedef struct
 {
     uint16_t  address;
@@ -86,14 +184,54 @@ typedef struct
     uint8_t       low;
     uint8_t      high;
     uint8_t    opcode;
-    char       *label;
+    uint16_t     slot; // Opcode, offset by PREFIX_SLOT when CB-prefixed.
+    char       *label; // Interrupts only, opcodes are labelled on demand.
     bool     executed;
     bool  cb_prefixed;
 
+    const DecodedInstruction *decoded;
+
     bool (*handler)(CPU*);
 
 } InstructionEntity;
 
+typedef enum
+{
+    SPIN_OFF,       // No loop under watch.
+    SPIN_ARMED,     // Loop body qualifies, waiting for its polling read.
+    SPIN_RECORDING, // Capturing one iteration cycle by cycle.
+    SPIN_ACTIVE     // Iterations absorbed until the polled value changes.
+
+} SpinState;
+
+typedef struct
+{
+    Register             reg;
+    LazyFlags          flags;
+    InstructionEntity    ins;
+    CodeBlock         *block;
+    uint8_t       block_next;
+    uint8_t      idle_cycles;
+
+} SpinFrame;
+
+typedef struct
+{
+    SpinState        state;
+    uint16_t          head; // Branch target.
+    uint16_t           end; // First address past the closing branch.
+    uint16_t       poll_pc; // PC once the polling load has fetched its operands.
+    uint16_t  poll_address;
+    uint8_t    poll_opcode;
+    uint8_t      poll_step; // Micro-step that performs the read.
+    uint8_t          value; // Polled value the loop is waiting on.
+    uint8_t         length; // Machine cycles per iteration.
+    uint8_t         offset;
+
+    SpinFrame frames[MAX_SPIN_CYCLES]; // CPU state at each cycle of one iteration.
+
+} IdleLoop;
+
 typedef struct CPU
 {
     uint8_t              ime_delay;
@@ -106,11 +244,37 @@ typedef struct CPU
     volatile bool  halt_bug_active;
 
     Register             reg;
+    LazyFlags          flags;
     InstructionEntity    ins;
 
+    // Decode Cache
+    CodeBlock    *blocks;
+    CodeBlock     *block;
+    uint8_t   block_next;
+    uint16_t  ram_blocks;
+
+    // Execution Modes
+    ExecMode   exec_mode;
+    bool      block_exec;
+    uint8_t  idle_cycles; // Machine cycles already spent by code run ahead of the clock.
+
+    _Atomic uint8_t mode_request; // ModeRequest bits, written by any thread.
+    TraceBuffer *_Atomic trace_request; // Buffer for MODE_REQUEST_TRACE.
+
+    // Idle Loop Detection
+    IdleLoop        spin;
+
+    // Execution Trace
+    TraceBuffer   *trace; // NULL when tracing is off, emulation thread only.
+
+    // Profiling
+    Profiler    *profiler; // NULL when profiling is off.
+    uint32_t profile_index; // Counter slot of the current instruction.
+
     Cartridge *cart;
     EmuMemory  *mem;
     EmuTimer *timer;
+    Scheduler *sched;
 
 } CPU;
 
@@ -118,10 +282,30 @@ char *get_cpu_state(CPU *cpu, char *buffer, size_t size);
 
 char *get_reg_state(CPU *cpu, char *buffer, size_t size);
 
+void resolve_flags(CPU *cpu);
+
 void request_interrupt(CPU *cpu, InterruptCode interrupt);
 
+void flush_ram_code(CPU *cpu);
+
 void machine_cycle(CPU *cpu);
 
+bool idle_cycle_ready(CPU *cpu);
+
+void enable_block_exec(CPU *cpu, bool enabled);
+
+void set_exec_mode(CPU *cpu, ExecMode mode);
+
+bool block_exec_requested(CPU *cpu);
+
+ExecMode exec_mode_requested(CPU *cpu);
+
+bool mode_requests_applied(CPU *cpu);
+
+void attach_tracer(CPU *cpu, TraceBuffer *trace);
+
+void attach_profiler(CPU *cpu, Profiler *profiler);
+
 void reset_cpu(CPU *cpu);
 
 void start_cpu(CPU *cpu);
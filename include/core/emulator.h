@@ -10,6 +10,7 @@ typedef struct EmuMemory EmuMemory;
 typedef struct EmuTimer EmuTimer;
 typedef struct APU APU;
 typedef struct PPU PPU;
+typedef struct Scheduler Scheduler;
 
 typedef enum
 {
@@ -57,6 +58,7 @@ typedef struct GbcEmu
     EmuTimer *timer;
     APU        *apu;
     PPU        *ppu;
+    Scheduler *sched;
 
     volatile bool running;
 
@@ -14,6 +14,12 @@
 #define WRAM_BANK_QUANTITY      8
 #define WAVE_RAM_SIZE          16
 #define OAM_SIZE              160
+#define HDMA_BYTE_DOTS          2
+#define CODE_MAP_SIZE      0x4000
+#define PAGE_SHIFT              8
+#define PAGE_SIZE           0x100
+#define PAGE_MASK            0xFF
+#define PAGE_COUNT          0x100
 
 typedef struct Joypad Joypad;
 typedef struct Cartridge Cartidge;
@@ -21,6 +27,7 @@ typedef struct CPU CPU;
 typedef struct EmuTimer EmuTimer;
 typedef struct APU APU;
 typedef struct PPU PPU;
+typedef struct Scheduler Scheduler;
 
 typedef struct
 {
@@ -29,8 +36,19 @@ typedef struct
     uint16_t    dst;
     uint16_t length;
 
+    bool       bulk; // Bytes are copied on demand instead of per event.
+    uint64_t  start; // Dot on which the first byte was copied.
+    uint8_t  period; // Dots per byte.
+
 } DmaTransfer;
 
+typedef enum
+{
+    CODE_GUARD = 0x01, // Page holds decoded instructions.
+    DMA_GUARD  = 0x02  // Page is the source of a bulk OAM DMA.
+
+} PageGuard;
+
 typedef enum
 {
     GENERAL_HDMA = 0,
@@ -49,7 +67,10 @@ typedef struct
 
     bool     bytes_transferring;
     uint16_t  bytes_transferred;
-    uint8_t             counter;
+
+    bool       bulk; // Chunk bytes are copied on demand instead of per event.
+    uint64_t  start; // Dot on which the chunk started.
+    uint16_t  chunk; // Bytes in the running chunk.
 
 } HdmaTransfer;
 
@@ -66,6 +87,12 @@ typedef struct EmuMemory
     uint8_t     **wram;
     uint8_t  *wave_ram;
     uint8_t       *oam;
+    bool     *code_map; // [$C000 - $FFFF] bytes held by the CPU decode cache.
+
+    // Page Tables, NULL pages are routed through their region handler.
+    uint8_t  *read_page[PAGE_COUNT];
+    uint8_t *write_page[PAGE_COUNT];
+    uint8_t       guard[PAGE_COUNT]; // PageGuard bits withholding a WRAM write pointer.
 
     DmaTransfer    dma;
     HdmaTransfer  hdma;
@@ -77,6 +104,7 @@ typedef struct EmuMemory
     EmuTimer    *timer;
     APU           *apu;
     PPU           *ppu;
+    Scheduler   *sched;
     
 } EmuMemory;
 
@@ -194,20 +222,64 @@ EmuMemory *init_memory();
 
 void link_mmu(EmuMemory *mem, GbcEmu *emu);
 
-void check_dma_transfer(EmuMemory *mem);
+void dma_event(EmuMemory *mem);
+
+void sync_oam_dma(EmuMemory *mem);
 
 void check_hdma_trigger(EmuMemory *mem);
 
-void check_hdma_transfer(EmuMemory *mem);
+void hdma_event(EmuMemory *mem);
+
+void sync_vram_dma(EmuMemory *mem);
 
 uint8_t read_vram_bank(EmuMemory *mem, uint8_t bank, uint16_t address);
 
 uint8_t read_cram(EmuMemory *mem, bool is_obj, uint8_t palette_index, uint8_t color_id, uint8_t index);
 
-uint8_t read_memory(EmuMemory *mem, uint16_t address);
+uint8_t read_unmapped(EmuMemory *mem, uint16_t address);
+
+static inline uint8_t read_memory(EmuMemory *mem, uint16_t address)
+{
+    uint8_t *page = mem->read_page[address >> PAGE_SHIFT];
+
+    if (page != NULL) 
+        return page[address & PAGE_MASK];
+
+    // High RAM shares the I/O page but is plain storage, skip its handler and mask.
+    if ((address >= HIGH_RAM_START) && (address <= HIGH_RAM_END))
+        return mem->memory[address];
+
+    return read_unmapped(mem, address);
+}
+
+void mark_ram_code(EmuMemory *mem, uint16_t address);
+
+void clear_ram_code(EmuMemory *mem);
+
+void remap_vram(EmuMemory *mem);
 
 void tidy_memory(EmuMemory **mem);
 
-void write_memory(EmuMemory *mem, uint16_t address, uint8_t value);
+void write_unmapped(EmuMemory *mem, uint16_t address, uint8_t value);
+
+static inline void write_memory(EmuMemory *mem, uint16_t address, uint8_t value)
+{
+    uint8_t *page = mem->write_page[address >> PAGE_SHIFT];
+
+    if (page != NULL)
+    {
+        page[address & PAGE_MASK] = value;
+        return;
+    }
+
+    // High RAM bytes cached as code still go through the handler to flush them.
+    if ((address >= HIGH_RAM_START) && (address <= HIGH_RAM_END) && !mem->code_map[address - WRAM_STATIC_START])
+    {
+        mem->memory[address] = value;
+        return;
+    }
+
+    write_unmapped(mem, address, value);
+}
 
 #endif
\ No newline at end of file
@@ -5,11 +5,14 @@
 #include <stdint.h>
 
 #define VISIBLE_TILES_PER_ROW  21
+#define TILE_CACHE_TILES      384 // $8000 - $97FF in each VRAM bank.
+#define PALETTE_SLOTS          32 // 8 palettes * 4 colors.
 
 typedef struct Cartridge Cartridge;
 typedef struct GbcEmu GbcEmu;
 typedef struct EmuMemory EmuMemory;
 typedef struct CPU CPU;
+typedef struct Scheduler Scheduler;
 
 typedef enum
 {
@@ -27,6 +30,15 @@ typedef enum
 
 } GraphicDefaults;
 
+typedef enum
+{
+    FRAME_ARGB8888  = 0, // 4 bytes per pixel, what the frontend shows.
+    FRAME_RGB565    = 1, // 2 bytes per pixel.
+    FRAME_INDEXED   = 2, // DMG shade 0-3, CGB CRAM color 0-63 with objects from 32.
+    FRAME_GRAYSCALE = 3  // 8-bit luma.
+
+} FrameFormat;
+
 typedef enum
 {
     WHITE      = 0xFFE0F8D0,
@@ -69,18 +81,46 @@ typedef struct
     uint8_t   row;
 
     uint8_t  attr;
-    uint8_t   lsb;
-    uint8_t   msb;
+
+    const uint8_t *pixels; // Color ids of the fetched row, x-flip applied.
 
 } Tile;
 
+typedef struct
+{
+    uint8_t rows[2][TILE_SIZE][TILE_SIZE]; // [x_flip][row][pixel] color ids.
+
+} DecodedTile;
+
+/*
+    Colors are resolved to the frame format when a palette is written, so
+    drawing a pixel is one load and one store. Slots are (palette << 2) | color id; DMG uses BGP
+    for BG slots 0-3 and OBP0/OBP1 for object slots 0-3/4-7.
+*/
+typedef struct
+{
+    uint32_t bgw[PALETTE_SLOTS];
+    uint32_t obj[PALETTE_SLOTS];
+
+} PaletteCache;
+
+typedef struct
+{
+    uint8_t                   count;
+    uint8_t entry[OBJS_PER_SCANLINE]; // OAM entry numbers, sorted by X.
+
+} SpriteLine;
+
 typedef struct PPU
 {
     bool tile_considered[VISIBLE_TILES_PER_ROW];
     
     PpuMode           mode;
-    uint16_t        sc_dot;
+    uint16_t        sc_dot; // Next dot of the line, counted up to dot_cycle.
+    uint64_t     dot_cycle; // Last dot the PPU has run or counted.
     uint8_t        penalty;
+    uint8_t   base_penalty; // SCX part of the penalty, where a FIFO replay starts.
+    uint16_t deferred_dots; // Mode 3 dots not yet run through the FIFO.
 
     uint8_t          *lcdc;
     uint8_t          *stat;
@@ -102,6 +142,7 @@ typedef struct PPU
     GbcEmu            *emu;
     EmuMemory         *mem;
     CPU               *cpu;
+    Scheduler       *sched;
 
     bool           init_sc;
     bool         init_tile;
@@ -109,18 +150,76 @@ typedef struct PPU
     bool      sc_rendering;
     bool       frame_delay;
     bool           running;
+    bool       frame_ready; // LY wrapped to 0, cleared by the clock driver.
 
     bool     stat_irq_line;
     bool           lyc_irq;
 
+    bool     batch_enabled;
+    bool      line_batched; // Current line is drawn in one pass at HBlank.
+
+    uint8_t  render_interval; // Draw one frame in N, 0 draws on request only.
+    uint8_t     render_phase;
+    bool    render_requested;
+    bool          skip_frame; // Frame in progress keeps its timing but draws nothing.
+    bool       frame_skipped; // Last completed frame was not drawn.
+
+    DecodedTile tile_cache[2][TILE_CACHE_TILES];
+    bool        tile_dirty[2][TILE_CACHE_TILES]; // Set on VRAM writes, cleared on decode.
+
+    PaletteCache   cgb_colors; // Updated on BCPD and OCPD writes.
+    PaletteCache   dmg_colors; // Updated on BGP, OBP0 and OBP1 writes.
+    PaletteCache      *colors; // The set the cartridge draws with.
+
+    FrameFormat frame_format;
+    uint8_t      pixel_bytes;
+
+    SpriteLine sprite_lines[GBC_HEIGHT];
+    bool          oam_dirty; // Set on OAM writes, cleared on rebuild.
+    bool       sprites_tall; // Object height the lists were built for.
+
 } PPU;
 
-bool ppu_dot(PPU *ppu);
+static inline void invalidate_tiles(PPU *ppu, uint8_t bank, uint16_t address, uint16_t length)
+{
+    if (address > B2_ADDRESS_END) return; // Tile maps are read raw.
+
+    uint16_t last = address + length - 1;
+    if (last > B2_ADDRESS_END) last = B2_ADDRESS_END;
+
+    for (uint16_t index = (address - B0_ADDRESS_START) >> 4; index <= ((last - B0_ADDRESS_START) >> 4); index++)
+        ppu->tile_dirty[bank][index] = true;
+}
+
+static inline void invalidate_oam(PPU *ppu)
+{
+    ppu->oam_dirty = true;
+}
+
+void ppu_event(PPU *ppu);
 
 char *get_ppu_state(PPU *ppu, char *buffer, size_t size);
 
 void write_ppu_register(PPU *ppu, uint16_t address, uint8_t value);
 
+void sync_scanline(PPU *ppu);
+
+void refresh_cram_color(PPU *ppu, bool is_obj, uint8_t index);
+
+void refresh_dmg_palette(PPU *ppu, uint16_t address);
+
+void enable_line_batching(PPU *ppu, bool enabled);
+
+void set_render_interval(PPU *ppu, uint8_t interval);
+
+void request_frame_render(PPU *ppu);
+
+bool last_frame_drawn(PPU *ppu);
+
+void set_frame_format(PPU *ppu, FrameFormat format);
+
+size_t frame_pitch(PPU *ppu);
+
 void *render_frame(PPU *ppu);
 
 void link_ppu(PPU *ppu, GbcEmu *emu);
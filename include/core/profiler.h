@@ -0,0 +1,68 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifndef PROFILE_SUPPORT
+#define PROFILE_SUPPORT  0 // Build with -DPROFILE_SUPPORT=1 (make BUILD=profile) to compile the profiler in.
+#endif
+
+#define PROFILE_OPCODE_SLOTS  513 // Base, CB-prefixed and interrupt dispatch slots.
+#define PROFILE_RAM_ENTRIES 0x10000 // $8000 - $FFFF with $D000 - $DFFF split per WRAM bank.
+#define PROFILE_REPORT_ROWS    64
+
+typedef struct Cartridge Cartridge;
+
+/*
+    Counters are flat arrays indexed by physical code location: one slot
+    per ROM byte, followed by the upper half of the address space with
+    each switchable WRAM bank given its own 4 KiB window.
+*/
+typedef struct Profiler
+{
+    uint32_t        rom_entries;
+    uint32_t            entries;
+
+    uint64_t         *pc_cycles; // Machine cycles spent per location.
+    uint64_t           *pc_hits; // Instructions retired per location.
+
+    uint64_t opcode_cycles[PROFILE_OPCODE_SLOTS];
+    uint64_t   opcode_hits[PROFILE_OPCODE_SLOTS];
+
+    uint64_t      halted_cycles;
+    uint64_t       total_cycles;
+
+} Profiler;
+
+static inline uint32_t profile_index(Profiler *prof, uint16_t address, uint16_t bank)
+{
+    if (address < 0x8000)
+        return (((uint32_t) bank * 0x4000) + (address & 0x3FFF)) % prof->rom_entries;
+
+    if ((address >= 0xD000) && (address <= 0xDFFF))
+        return prof->rom_entries + 0x8000 + ((uint32_t) (bank & 0x07) * 0x1000) + (address & 0x0FFF);
+
+    return prof->rom_entries + (address - 0x8000);
+}
+
+static inline void profile_cycle(Profiler *prof, uint32_t index, uint16_t slot)
+{
+    prof->pc_cycles[index]++;
+    prof->opcode_cycles[slot]++;
+    prof->total_cycles++;
+}
+
+static inline void profile_retire(Profiler *prof, uint32_t index, uint16_t slot)
+{
+    prof->pc_hits[index]++;
+    prof->opcode_hits[slot]++;
+}
+
+bool write_profile_report(Profiler *prof, const char *text_path, const char *json_path);
+
+Profiler *init_profiler(Cartridge *cart);
+
+void tidy_profiler(Profiler **prof);
+
+#endif
\ No newline at end of file
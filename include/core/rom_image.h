@@ -0,0 +1,44 @@
+#ifndef ROM_IMAGE_H
+#define ROM_IMAGE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+    ROM files are mapped read-only and shared: every cartridge loaded from
+    the same path with the same contents holds a reference to one image,
+    so N instances of a game keep one set of physical pages. Images are
+    matched on path and file identity, so a file is only mapped and
+    hashed again once it has been replaced or modified.
+*/
+typedef struct
+{
+    uint64_t  device;
+    uint64_t   inode; // File index on Windows.
+    uint64_t   mtime; // Nanoseconds on POSIX, 100ns ticks on Windows.
+    uint64_t    size;
+
+} FileIdentity;
+
+typedef struct RomImage
+{
+    uint8_t    *data;
+    size_t      size;
+    uint64_t    hash; // FNV-1a over the contents.
+    char       *path;
+    FileIdentity id; // Identity of the file that was mapped.
+    bool      mapped; // False for private heap copies.
+    int   references;
+
+    struct RomImage *next; // Registry chain.
+
+} RomImage;
+
+RomImage *acquire_rom_image(const char *file_path);
+
+RomImage *pad_rom_image(RomImage *image, size_t size);
+
+void release_rom_image(RomImage *image);
+
+#endif
\ No newline at end of file
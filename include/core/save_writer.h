@@ -0,0 +1,43 @@
+#ifndef SAVE_WRITER_H
+#define SAVE_WRITER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+#define SAVE_PAGE_SHIFT                    8
+#define SAVE_PAGE_SIZE (1 << SAVE_PAGE_SHIFT)
+
+/*
+    Battery saves are double buffered. The emulation thread copies the RAM
+    pages dirtied since its last snapshot into the staged image, and the
+    writer thread copies the staged image out under the lock before it 
+    replaces the save file through a temporary one. A process killed at
+    any point leaves either the previous save or the new one on disk.
+*/
+typedef struct SaveWriter
+{
+    char         *path;
+    char         *temp;
+    size_t        size; // RAM followed by the tail (RTCC).
+    size_t   ram_size;
+
+    uint8_t   *staged; // Filled by snapshots, guarded by lock.
+    uint8_t *flushing; // Owned by the flushing thread.
+
+    atomic_flag              lock;
+    _Atomic uint32_t staged_count; // Snapshots taken.
+    uint32_t        flushed_count; // Snapshots on disk, owned by the flushing thread.
+
+} SaveWriter;
+
+SaveWriter *init_save_writer(const char *path, const uint8_t *ram, size_t ram_size, const void *tail, size_t tail_size);
+
+void stage_save_pages(SaveWriter *writer, const uint8_t *ram, uint32_t *dirty_pages, const void *tail, size_t tail_size);
+
+bool flush_save_writer(SaveWriter *writer);
+
+void tidy_save_writer(SaveWriter **writer);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,64 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define NO_EVENT UINT64_MAX
+
+typedef struct GbcEmu GbcEmu;
+typedef struct EmuMemory EmuMemory;
+typedef struct EmuTimer EmuTimer;
+typedef struct PPU PPU;
+
+// Events sharing a timestamp are dispatched in declaration order.
+typedef enum
+{
+    PPU_EVENT,  // Mode change or line end, every dot of a mode 3 run through the FIFO.
+    HDMA_EVENT, // VRAM DMA, one byte every two dots.
+    DMA_EVENT,  // OAM DMA, one byte per machine cycle.
+    TIMA_EVENT, // TIMA overflow -> reload -> interrupt sequence.
+
+    EVENT_QUANTITY
+
+} EventType;
+
+typedef struct
+{
+    uint64_t timestamp;
+    EventType     type;
+
+} Event;
+
+typedef struct Scheduler
+{
+    uint64_t cycle; // Absolute dot counter.
+    uint64_t  next; // Timestamp of the earliest pending event.
+
+    Event  heap[EVENT_QUANTITY]; // Min-heap ordered by timestamp.
+    int8_t slot[EVENT_QUANTITY]; // Heap index per event type, -1 when idle.
+    uint8_t size;
+
+    EmuMemory *mem;
+    EmuTimer *timer;
+    PPU        *ppu;
+
+} Scheduler;
+
+void schedule_event(Scheduler *sched, EventType type, uint64_t delay);
+
+void schedule_machine_event(Scheduler *sched, EventType type);
+
+void cancel_event(Scheduler *sched, EventType type);
+
+bool event_pending(Scheduler *sched, EventType type);
+
+void dispatch_events(Scheduler *sched);
+
+void link_scheduler(Scheduler *sched, GbcEmu *emu);
+
+Scheduler *init_scheduler();
+
+void tidy_scheduler(Scheduler **sched);
+
+#endif
\ No newline at end of file
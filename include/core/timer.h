@@ -11,6 +11,7 @@ typedef struct CPU CPU;
 typedef struct EmuMemory EmuMemory;
 typedef struct APU APU;
 typedef struct PPU PPU;
+typedef struct Scheduler Scheduler;
 
 static const uint8_t sys_shift_table[4] = 
 {
@@ -42,13 +43,17 @@ typedef struct EmuTimer
     bool     prev_sys_bit;
     bool     prev_apu_bit;
 
-    uint32_t          dot;
+    uint32_t          dot; // Dots until the next machine cycle.
+
+    uint16_t   halt_skipped; // Machine cycles absorbed while halted or idle, owed to SYS.
+    uint16_t   halt_horizon; // Machine cycles that can be absorbed before the next timer edge.
 
     Cartridge       *cart;
     CPU              *cpu;
     EmuMemory        *mem;
     APU              *apu;
     PPU              *ppu;
+    Scheduler      *sched;
     
 } EmuTimer;
 
@@ -56,10 +61,16 @@ char *get_emu_time(EmuTimer *timer, char *buffer, size_t size);
 
 void write_timer_register(EmuTimer *timer, uint16_t address, uint8_t value);
 
+void tima_event(EmuTimer *timer);
+
+uint16_t quiet_cycles(EmuTimer *timer);
+
 bool system_clock_pulse(EmuTimer *timer);
 
 bool machine_clock_pulse(EmuTimer *timer);
 
+bool machine_clock_span(EmuTimer *timer, uint32_t dots);
+
 void link_timer(EmuTimer *timer, GbcEmu *emu);
 
 char *get_emu_time(EmuTimer *timer, char *buffer, size_t size);
@@ -1,6 +1,8 @@
 #ifndef CIRCULAR_QUEUE_H
 #define CIRCULAR_QUEUE_H
 
+#include "util/pixel_fifo.h" // OamObject
+
 typedef enum
 {
     PIXEL,
@@ -17,23 +19,6 @@ typedef struct
 
 } GbcPixel;
 
-typedef struct
-{
-    uint16_t oam_address; // Object start in memory.
-
-    uint8_t            y; // Byte-1
-    uint8_t            x; // Byte-2
-    uint8_t   tile_index; // Byte-3
-    // Byte-4
-    bool        priority; // Bit-7
-    bool          y_flip; // Bit-6 
-    bool          x_flip; // Bit-5
-    uint8_t  dmg_palette; // Bit-4
-    uint8_t         bank; // Bit-3
-    uint8_t  cgb_palette; // Bits 2-0
-
-} OamObject; 
-
 typedef struct
 {
     void      **items;
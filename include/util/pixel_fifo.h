@@ -0,0 +1,147 @@
+#ifndef PIXEL_FIFO_H
+#define PIXEL_FIFO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define PIXEL_FIFO_CAPACITY  16 // Power of two, indices wrap with a mask.
+#define OBJECT_FIFO_CAPACITY 16 // Holds the 10 objects of a scanline.
+#define FIFO_ROW              8 // Pixels per tile row.
+
+#define PIXEL_FIFO_MASK  (PIXEL_FIFO_CAPACITY  - 1)
+#define OBJECT_FIFO_MASK (OBJECT_FIFO_CAPACITY - 1)
+
+/*
+    Pixel attributes are packed into one byte laid out like the OAM and
+    BG map attribute bytes: bit 7 priority, bit 4 DMG palette and bits
+    2-0 CGB palette. Color ids sit in their own array beside them so a
+    decoded tile row is pushed with straight byte copies.
+*/
+#define PIXEL_ATTR_MASK (uint8_t) 0x97
+
+typedef struct
+{
+    uint16_t oam_address; // Object start in memory.
+
+    uint8_t            y; // Byte-1
+    uint8_t            x; // Byte-2
+    uint8_t   tile_index; // Byte-3
+    // Byte-4
+    bool        priority; // Bit-7
+    bool          y_flip; // Bit-6
+    bool          x_flip; // Bit-5
+    uint8_t  dmg_palette; // Bit-4
+    uint8_t         bank; // Bit-3
+    uint8_t  cgb_palette; // Bits 2-0
+
+} OamObject;
+
+typedef struct
+{
+    uint8_t color[PIXEL_FIFO_CAPACITY];
+    uint8_t  attr[PIXEL_FIFO_CAPACITY];
+
+    uint8_t front;
+    uint8_t  size;
+
+} PixelFifo;
+
+typedef struct
+{
+    OamObject items[OBJECT_FIFO_CAPACITY];
+
+    uint8_t front;
+    uint8_t  size;
+
+} ObjectFifo;
+
+// Pixel FIFO
+
+static inline void reset_pixel_fifo(PixelFifo *fifo)
+{
+    fifo->front = 0;
+    fifo-> size = 0;
+}
+
+static inline uint8_t pop_pixel(PixelFifo *fifo) // Returns the slot, the caller checks size.
+{
+    uint8_t slot = fifo->front;
+
+    fifo->front = (fifo->front + 1) & PIXEL_FIFO_MASK;
+    fifo-> size--;
+
+    return slot;
+}
+
+static inline void drop_pixels(PixelFifo *fifo, uint8_t count) // Stops at empty.
+{
+    count = (count < fifo->size) ? count : fifo->size;
+
+    fifo->front = (fifo->front + count) & PIXEL_FIFO_MASK;
+    fifo-> size = fifo->size - count;
+}
+
+static inline void push_pixel_row(PixelFifo *fifo, const uint8_t *colors, uint8_t attr)
+{
+    for (uint8_t i = 0; i < FIFO_ROW; i++)
+    {
+        uint8_t slot = (fifo->front + fifo->size + i) & PIXEL_FIFO_MASK;
+        fifo->color[slot] = colors[i];
+        fifo-> attr[slot] = attr;
+    }
+
+    fifo->size += FIFO_ROW;
+}
+
+/*
+    Pads the FIFO with transparent pixels up to a full row, then lays an
+    object row over it. Pixels already opaque belong to an earlier object
+    and are kept.
+*/
+static inline void merge_pixel_row(PixelFifo *fifo, const uint8_t *colors, uint8_t attr)
+{
+    for (uint8_t i = 0; i < FIFO_ROW; i++)
+    {
+        uint8_t  slot = (fifo->front + i) & PIXEL_FIFO_MASK;
+        uint8_t  live = (uint8_t) -(i < fifo->size);
+        uint8_t color = fifo->color[slot] & live;
+        uint8_t  keep = (uint8_t) -(color != 0);
+
+        fifo->color[slot] = (color & keep) | (colors[i] & ~keep);
+        fifo-> attr[slot] = (fifo->attr[slot] & keep) | (attr & ~keep);
+    }
+
+    fifo->size = (fifo->size > FIFO_ROW) ? fifo->size : FIFO_ROW;
+}
+
+// Object FIFO
+
+static inline void reset_object_fifo(ObjectFifo *fifo)
+{
+    fifo->front = 0;
+    fifo-> size = 0;
+}
+
+static inline void push_object(ObjectFifo *fifo, const OamObject *obj)
+{
+    fifo->items[(fifo->front + fifo->size) & OBJECT_FIFO_MASK] = *obj;
+    fifo->size++;
+}
+
+static inline OamObject *peek_object(ObjectFifo *fifo)
+{
+    return (fifo->size == 0) ? NULL : &fifo->items[fifo->front];
+}
+
+static inline OamObject *object_at(ObjectFifo *fifo, uint8_t index)
+{
+    return &fifo->items[(fifo->front + index) & OBJECT_FIFO_MASK];
+}
+
+static inline void pop_object(ObjectFifo *fifo)
+{
+    fifo->front = (fifo->front + 1) & OBJECT_FIFO_MASK;
+    fifo-> size--;
+}
+
+#endif
\ No newline at end of file
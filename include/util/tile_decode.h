@@ -0,0 +1,34 @@
+#ifndef TILE_DECODE_H
+#define TILE_DECODE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define TILE_DATA_BYTES 16 // Eight rows of two bitplanes.
+#define TILE_PIXELS     64
+
+typedef enum
+{
+    DECODE_SCALAR = 0,
+    DECODE_SSE2   = 1,
+    DECODE_BMI2   = 2  // PDEP bit scatter.
+
+} DecodeKernel;
+
+/*
+    Decodes one 2bpp tile into 64 color ids, row-major, once as stored 
+    and once with every row mirrored for x-flipped fetches.
+*/
+typedef void (*TileDecoder)(const uint8_t *data, uint8_t *plain, uint8_t *flipped);
+
+extern TileDecoder decode_tile_rows;
+
+DecodeKernel detect_decode_kernel();
+
+bool select_decode_kernel(DecodeKernel kernel);
+
+const char *decode_kernel_name(DecodeKernel kernel);
+
+void init_tile_decoder();
+
+#endif
\ No newline at end of file
@@ -0,0 +1,91 @@
+#ifndef TRACE_BUFFER_H
+#define TRACE_BUFFER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#define TRACE_BUFFER_CAPACITY (uint32_t) (1 << 16) // 2^16 records * 32 Bytes = 2 MiB
+
+typedef enum
+{
+    TRACE_INSTRUCTION = 0,
+    TRACE_INTERRUPT   = 1
+
+} TraceKind;
+
+/*
+    Records are written to trace files as-is, in host byte order, and read
+    back by tools/trace_dump.c.
+*/
+typedef struct
+{
+    uint64_t    cycle; // Scheduler dot count when the opcode was fetched.
+    uint16_t       pc; // Interrupt vector for TRACE_INTERRUPT.
+    uint16_t     bank; // ROM or WRAM bank mapped at PC.
+    uint16_t       sp;
+    uint8_t      kind;
+    uint8_t  bytes[3]; // Opcode and operands, interrupt code for TRACE_INTERRUPT.
+    uint8_t         A; uint8_t F;
+    uint8_t         B; uint8_t C;
+    uint8_t         D; uint8_t E;
+    uint8_t         H; uint8_t L;
+
+} TraceRecord;
+
+typedef struct TraceBuffer
+{
+    TraceRecord records[TRACE_BUFFER_CAPACITY];
+
+    _Atomic uint32_t  read_pos; // Free-running, owned by the consumer.
+    _Atomic uint32_t write_pos; // Free-running, owned by the producer.
+    _Atomic uint64_t   dropped; // Records lost to a full buffer.
+
+} TraceBuffer;
+
+static inline void reset_trace_buffer(TraceBuffer *tb)
+{
+    atomic_store(&tb->read_pos,  0);
+    atomic_store(&tb->write_pos, 0);
+    atomic_store(&tb->dropped,   0);
+}
+
+static inline TraceRecord *trace_buffer_claim(TraceBuffer *tb) // Producer only.
+{
+    uint32_t write = atomic_load_explicit(&tb->write_pos, memory_order_relaxed);
+    uint32_t  read = atomic_load_explicit(&tb->read_pos,  memory_order_acquire);
+
+    if ((write - read) == TRACE_BUFFER_CAPACITY)
+    {
+        atomic_fetch_add_explicit(&tb->dropped, 1, memory_order_relaxed);
+        return NULL;
+    }
+
+    return &tb->records[write & (TRACE_BUFFER_CAPACITY - 1)];
+}
+
+static inline void trace_buffer_commit(TraceBuffer *tb) // Publishes the claimed record.
+{
+    uint32_t write = atomic_load_explicit(&tb->write_pos, memory_order_relaxed);
+    atomic_store_explicit(&tb->write_pos, write + 1, memory_order_release);
+}
+
+static inline uint32_t trace_buffer_drain(TraceBuffer *tb, TraceRecord *out, uint32_t max) // Consumer only.
+{
+    uint32_t  read = atomic_load_explicit(&tb->read_pos,  memory_order_relaxed);
+    uint32_t write = atomic_load_explicit(&tb->write_pos, memory_order_acquire);
+
+    uint32_t count = write - read;
+    uint32_t start = read & (TRACE_BUFFER_CAPACITY - 1);
+
+    if (count > max) count = max;
+    if (count > (TRACE_BUFFER_CAPACITY - start)) count = TRACE_BUFFER_CAPACITY - start; // Up to the wrap.
+
+    memcpy(out, &tb->records[start], count * sizeof(TraceRecord));
+    atomic_store_explicit(&tb->read_pos, read + count, memory_order_release);
+
+    return count;
+}
+
+#endif
\ No newline at end of file
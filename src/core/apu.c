@@ -339,29 +339,35 @@ static inline uint8_t get_duty_cycle(Channel *ch)
     return (*ch->nrx1 >> 6) & LOWER_2_MASK;
 }
 
-static void clock_pulse_divider(Channel *ch)
+static inline uint32_t divider_room(Channel *ch) // Clocks until the divider overflows.
 {
-    ch->divider++;
+    return (ch->divider < PERIOD_OVERFLOW) ? (uint32_t) (PERIOD_OVERFLOW - ch->divider) + 1 : 1;
+}
 
-    if (ch->divider > PERIOD_OVERFLOW)
+static void clock_pulse_divider(Channel *ch, uint32_t clocks)
+{
+    while (clocks >= divider_room(ch))
     {
+        clocks -= divider_room(ch);
+
         ch->   divider = get_period(ch);
         ch->      step = (ch->step + 1) % 8;
         bool wave_high = (wave_forms[get_duty_cycle(ch)][ch->step] != 0);
         ch->    output = wave_high ? ch->volume : 0;
     }
+
+    ch->divider += clocks;
 }
 
-static void clock_pulse_timer(Channel *ch)
+static void clock_pulse_timer(Channel *ch, uint32_t dots)
 {
     if (!ch->enabled)
         return;
     
-    ch->timer++;
-    if (ch->timer < 4) return;
-    ch->timer = 0;
+    uint32_t elapsed = ch->timer + dots;
+    ch->timer = elapsed % 4;
 
-    clock_pulse_divider(ch);
+    clock_pulse_divider(ch, elapsed / 4);
 }
 
 // Wave Channel Waveform Handling
@@ -391,35 +397,34 @@ static void advance_general_waveform(APU *apu, Channel *ch)
     ch->step = (ch->step + 1) % 32;
 }
 
-static void clock_wave_divider(APU *apu, Channel *ch)
+static void clock_wave_divider(APU *apu, Channel *ch, uint32_t clocks)
 {
-    ch->divider++;
-
-    if (ch->divider > PERIOD_OVERFLOW)
+    while (clocks >= divider_room(ch))
     {
+        clocks -= divider_room(ch);
+
         ch->divider = get_period(ch);
         advance_general_waveform(apu, ch);
     }
+
+    ch->divider += clocks;
 }
 
-static void clock_wave_timer(APU *apu)
+static void clock_wave_timer(APU *apu, uint32_t dots)
 {
     Channel *ch3 = &(apu->ch3);
 
     if (!ch3->enabled)
         return;
 
-    if (ch3->phase != 0)
-    {
-        ch3->phase--;
-        return;
-    }
+    uint32_t delay = (ch3->phase < dots) ? ch3->phase : dots; // Startup dots leave the timer alone.
+    ch3->phase -= delay;
+    dots       -= delay;
 
-    ch3->timer++;
-    if (ch3->timer < 2) return;
-    ch3->timer = 0;
+    uint32_t elapsed = ch3->timer + dots;
+    ch3->timer = elapsed % 2;
 
-    clock_wave_divider(apu, ch3);
+    clock_wave_divider(apu, ch3, elapsed / 2);
 }
 
 // Noise Channel Waveform Handling
@@ -444,28 +449,34 @@ static void clock_lfsr(Channel *ch)
     ch->output = (feedback == 0) ? 0 : ch->volume; 
  }
 
-static void clock_noise_timer(APU *apu)
+static void clock_noise_timer(APU *apu, uint32_t dots)
 {
     Channel *ch = &(apu->ch4); 
 
     if (!ch->enabled)
         return;
     
-    ch->timer++;
-    if (ch->timer < noise_period) return;
-    ch->timer = 0;
+    uint32_t elapsed = ch->timer + dots;
+    ch->timer = elapsed % noise_period;
 
-    clock_lfsr(ch);
+    for (uint32_t clocks = elapsed / noise_period; clocks > 0; clocks--)
+        clock_lfsr(ch);
 }
 
 // Waveform Driver
 
-void apu_dot(APU *apu)
-{
-    clock_pulse_timer(&apu->ch1);
-    clock_pulse_timer(&apu->ch2);
-    clock_wave_timer(apu);
-    clock_noise_timer(apu);
+/*
+    Channel timers only change their output when their divider overflows,
+    so the dots between two machine cycles are run as one span. Nothing
+    the APU reads can change inside a span, registers are only written on
+    machine cycles.
+*/
+void apu_advance(APU *apu, uint32_t dots)
+{
+    clock_pulse_timer(&apu->ch1, dots);
+    clock_pulse_timer(&apu->ch2, dots);
+    clock_wave_timer(apu, dots);
+    clock_noise_timer(apu, dots);
 }
 
 // Channel Triggering
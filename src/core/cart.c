@@ -1,6 +1,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
 #include <sys/stat.h> 
 #include <sys/types.h>
 
@@ -15,6 +16,9 @@
 #include "core/cart.h"
 #include "core/emulator.h"
 #include "core/mmu.h"
+#include "core/scheduler.h"
+#include "core/rom_image.h"
+#include "core/save_writer.h"
 
 #include "util/common.h"
 
@@ -28,74 +32,55 @@ static inline void strip_extension(char *file_name)
         *dot = '\0';
 }
 
-static bool save_file_needed(Cartidge *cart)
+static void get_save_path(Cartridge *cart, char *save_path, size_t size)
 {
     const char *file_name = cart->file_name;
     char  *file_name_copy = (char*) malloc(strlen(file_name) + 1);
 
     if (file_name_copy)
         strcpy(file_name_copy, file_name);
-    
+
     strip_extension(file_name_copy);
-    char save_path[MAX_FILE_PATH];
-    snprintf(save_path, sizeof(save_path), "./%s/%s.sav", SAVE_DIR, file_name_copy);
+    snprintf(save_path, size, "./%s/%s.sav", SAVE_DIR, file_name_copy);
     free(file_name_copy);
-    
-    FILE *file = fopen(save_path, "rb");
+}
 
-    if (!file) 
-        return true;
+static void sync_rtc(Cartridge *cart);
 
-    fclose(file);
-    
-    return false;
+static void stamp_clock(Cartridge *cart) // Saved clocks carry the wall time they were taken at.
+{
+    sync_rtc(cart);
+    cart->clock.saved_at = (int64_t) time(NULL);
 }
 
-static bool save_game(Cartidge *cart)
+/*
+    Time spent with the emulator closed is added on load, in one step. 
+    Saves without a stamp, and clocks set ahead of the host, are left as is.
+*/
+static void catch_up_clock(Cartridge *cart)
 {
-    const char *file_name = cart->file_name;
-    const uint8_t    *ram = cart->      ram;
-    size_t           size = cart-> ram_size;
-
-    mkdir_if_needed(SAVE_DIR);
-
-    char *file_name_copy = (char*) malloc(strlen(file_name) + 1);
+    int64_t now = (int64_t) time(NULL);
 
-    if (file_name_copy)
-        strcpy(file_name_copy, file_name);
-    
-    strip_extension(file_name_copy);
-    char save_path[MAX_FILE_PATH];
-    snprintf(save_path, sizeof(save_path), "./%s/%s.sav", SAVE_DIR, file_name_copy);
-    free(file_name_copy);
+    if ((cart->clock.saved_at <= 0) || (now <= cart->clock.saved_at)) 
+        return;
 
-    FILE *file = fopen(save_path, "wb");
+    rtc_advance(cart, (uint64_t) (now - cart->clock.saved_at));
+}
 
-    if (!file)
+static bool save_game(Cartridge *cart)
+{
+    if (cart->saver == NULL) 
         return false;
 
-    fwrite(ram, 1, size, file);
-    fwrite(&cart->clock, 1, sizeof(RTCC), file);
-    fclose(file);
-
-    return true;
+    stamp_clock(cart);
+    stage_save_pages(cart->saver, cart->ram, cart->dirty_pages, &cart->clock, sizeof(RTCC));
+    return flush_save_writer(cart->saver);
 }
 
-static bool load_game(Cartridge *cart)
+static bool load_game(Cartridge *cart, const char *save_path)
 {
-    const char *file_name = cart->file_name;
-    uint8_t          *ram = cart->      ram;
-    size_t           size = cart-> ram_size;
-
-    char *file_name_copy = (char*) malloc(strlen(file_name) + 1);
-
-    if (file_name_copy)
-        strcpy(file_name_copy, file_name);
-
-    strip_extension(file_name_copy);
-    char save_path[MAX_FILE_PATH];
-    snprintf(save_path, sizeof(save_path), "./%s/%s.sav", SAVE_DIR, file_name_copy);
-    free(file_name_copy);
+    uint8_t *ram = cart->     ram;
+    size_t  size = cart->ram_size;
 
     FILE *file = fopen(save_path, "rb");
 
@@ -103,51 +88,34 @@ static bool load_game(Cartridge *cart)
         return false;
 
     fread(ram, 1, size, file);
-    fread(&cart->clock, 1, sizeof(RTCC), file);
+    fread(&cart->clock, 1, sizeof(RTCC), file); // Older saves end before the divider and stamp.
     fclose(file);
 
+    catch_up_clock(cart);
+
     return true;
 }
 
-static uint8_t *get_rom_content(Cartridge *cart, const char *file_path) // Reads file and returns pointer to loaded content.
-{  
-    FILE *file = fopen(file_path, "rb");
-
-    if (!file) 
-    {
-        perror("Unable to find file!");
-        return NULL;
-    }
-
-    // Move to end of file to find its size.
-    fseek(file, 0, SEEK_END);
-    long file_size = ftell(file);
-    rewind(file);
+static bool ram_dirty(Cartridge *cart)
+{
+    uint32_t words = ((cart->ram_size >> SAVE_PAGE_SHIFT) + 31) >> 5;
 
-    // Allocate memory to a buffer.
-    uint8_t *buffer = (uint8_t*) malloc(file_size);
+    for (uint32_t i = 0; i < words; i++)
+        if (cart->dirty_pages[i] != 0) return true;
 
-    if (!buffer) 
-    {
-        fclose(file);
-        return NULL;
-    }
+    return false;
+}
 
-    // Read value into buffer.
-    long bytesRead = fread(buffer, 1, file_size, file);
+static uint8_t *get_rom_content(Cartridge *cart, const char *file_path) // Maps the file and returns pointer to its content.
+{  
+    cart->image = acquire_rom_image(file_path);
 
-    if (bytesRead != file_size) 
-    {
-        fclose(file);
+    if (cart->image == NULL) 
         return NULL;
-    }
 
-    cart->file_size = file_size;
-
-    // Tidy up.
-    fclose(file);
+    cart->file_size = (long) cart->image->size;
 
-    return buffer;
+    return cart->image->data;
 }
 
 static void encode_rom_title(Header *header, uint8_t *rom)   // Loads cartridge title from ROM.
@@ -181,34 +149,86 @@ static uint8_t get_address_code(uint16_t address)
     return (address >> 13);
 }
 
-static uint8_t read_rom(Cartridge *cart, uint16_t bank, uint16_t address)
+static inline uint8_t read_rom0(Cartridge *cart, uint16_t address)
 {
-    bank &= cart->rom_bank_mask;
-    uint32_t offset = bank * ROM_BANK_SIZE;
-    return cart->rom[offset + address];
+    return cart->rom0_base[address];
 }
 
-static uint8_t read_ram(Cartridge *cart, uint8_t bank, uint16_t address)
+static inline uint8_t read_romx(Cartridge *cart, uint16_t address)
 {
-    if (!cart->ram_enabled) 
+    return cart->romx_base[address - ROM_DYNAMIC_START];
+}
+
+static inline uint8_t read_ram(Cartridge *cart, uint16_t address)
+{
+    if (cart->ram_base == NULL) 
         return OPEN_BUS;
 
-    uint32_t  index = address - EXT_RAM_START;
-    uint32_t offset = bank * RAM_BANK_SIZE;
-    index += offset;
+    return cart->ram_base[address - EXT_RAM_START];
+}
 
-    return 
-        cart->ram[index % cart->ram_size];
+static inline void mark_ram_dirty(Cartridge *cart, uint32_t offset)
+{
+    uint32_t page = offset >> SAVE_PAGE_SHIFT;
+    cart->dirty_pages[page >> 5] |= (uint32_t) 1 << (page & 31);
 }
 
-static void write_ram(Cartridge *cart, uint16_t bank, uint16_t address, uint8_t value)
+static inline void write_ram(Cartridge *cart, uint16_t address, uint8_t value)
 {
-    if (!cart->ram_enabled) return;
+    if (cart->ram_base == NULL) return;
+
+    uint32_t offset = (uint32_t) (cart->ram_base - cart->ram) + (address - EXT_RAM_START);
 
-    uint32_t  index = address - EXT_RAM_START;
-    uint32_t offset = bank * RAM_BANK_SIZE;
-    index += offset;
-    cart->ram[index % cart->ram_size] = value;
+    cart->ram[offset] = value;
+    mark_ram_dirty(cart, offset);
+}
+
+// Bank Mapping
+
+#define NO_RAM_BANK -1
+
+static int16_t mapped_ram_bank(Cartridge *cart)
+{
+    if (!cart->ram_enabled) return NO_RAM_BANK;
+
+    switch(cart->header.cart_code)
+    {
+        case MBC1:
+        case MBC1_RAM:
+        case MBC1_RAM_BATTERY:
+            return (cart->mode == RAM_MODE) ? cart->upper : 0;
+
+        case MBC3:
+        case MBC3_RAM:
+        case MBC3_RAM_BATTERY:
+        case MBC3_TIMER_BATTERY:
+        case MBC3_TIMER_RAM_BATTERY:
+            return (cart->mode == RAM_MODE) ? cart->upper : NO_RAM_BANK; // RTC registers.
+
+        case MBC5:
+        case MBC5_RAM:
+        case MBC5_RAM_BATTERY:
+        case MBC5_RUMBLE:
+        case MBC5_RUMBLE_RAM:
+        case MBC5_RUMBLE_RAM_BATTERY:
+            return cart->upper;
+    }
+
+    return NO_RAM_BANK; // No RAM, or MBC2's 4-bit cells.
+}
+
+/*
+    Called whenever a bank, mode or enable register is written so reads
+    never redo the bank selection, masking or wrapping.
+*/
+static void map_banks(Cartridge *cart)
+{
+    int16_t ram_bank = mapped_ram_bank(cart);
+
+    cart->rom0_base = cart->rom + ((uint32_t) cart->rom0_bank * ROM_BANK_SIZE);
+    cart->romx_base = cart->rom + ((uint32_t) cart->romx_bank * ROM_BANK_SIZE);
+    cart-> ram_base = (ram_bank == NO_RAM_BANK) ? NULL :
+        cart->ram + (((uint32_t) ram_bank * RAM_BANK_SIZE) % cart->ram_size);
 }
 
 
@@ -223,11 +243,11 @@ static uint8_t read_rom_only(Cartridge *cart, uint16_t address)
     {
         case 0: // $0000-$1FFF
         case 1: // $2000-$3FFF
-            return read_rom(cart, 0, address);
+            return read_rom0(cart, address);
 
         case 2: // $4000-$5FFF
         case 3: // $6000-$7FFF
-            return read_rom(cart, 1, (address - ROM_BANK_SIZE));   
+            return read_romx(cart, address);   
     }
 
     return OPEN_BUS;
@@ -250,26 +270,30 @@ static uint8_t rom_bank_sel_mbc1(Cartridge *cart)
     return bank;
 }
 
-static uint8_t read_mbc1(Cartridge *cart, uint16_t address)
+static void sync_banks_mbc1(Cartridge *cart)
 {
-    uint8_t rom_bank = 0;
+    uint8_t rom0_bank = (cart->upper_bank_enabled && (cart->mode == RAM_MODE)) ? (cart->upper << 5) : 0;
+
+    cart->rom0_bank = rom0_bank & cart->rom_bank_mask;
+    cart->romx_bank = rom_bank_sel_mbc1(cart) & cart->rom_bank_mask;
+
+    map_banks(cart);
+}
 
+static uint8_t read_mbc1(Cartridge *cart, uint16_t address)
+{
     switch(get_address_code(address))
     {
         case 0: // $0000 - $1FFF
         case 1: // $2000 - $3FFF
-            rom_bank = (cart->upper_bank_enabled && (cart->mode == RAM_MODE)) ?
-            (cart->upper << 5) : 0;
-            return read_rom(cart, rom_bank, address);
+            return read_rom0(cart, address);
 
         case 2: // $4000 - $5FFF
         case 3: // $6000 - $7FFF
-            rom_bank = rom_bank_sel_mbc1(cart);
-            return read_rom(cart, rom_bank, (address - ROM_BANK_SIZE));
+            return read_romx(cart, address);
 
         case 5: // $A000 - $BFFF
-            uint8_t ram_bank = (cart->mode == RAM_MODE) ? cart->upper : 0;
-            return read_ram(cart, ram_bank, address);
+            return read_ram(cart, address);
     }
 
     return OPEN_BUS;
@@ -281,23 +305,26 @@ static void write_mbc1(Cartridge *cart, uint16_t address, uint8_t value)
     {
         case 0: // $0000 - $1FFF - RAM Enable
             cart->ram_enabled = ((value & LOWER_4_MASK) == 0x0A);
+            map_banks(cart);
             return;
             
         case 1: // $2000 - $3FFF - ROM Bank, Lower 5
             cart->lower = value & LOWER_5_MASK;
+            sync_banks_mbc1(cart);
             return;
 
         case 2: // $4000 - $5FFF - RAM Bank, Upper 2
             cart->upper = value & LOWER_2_MASK;
+            sync_banks_mbc1(cart);
             return;
 
         case 3: // $6000 - $7FFF - Mode Select, (0 - ROM) (1 - RAM)
             cart->mode = value & BIT_0_MASK;
+            sync_banks_mbc1(cart);
             return;
 
         case 5: // $A000 - $BFFF
-            uint8_t ram_bank = (cart->mode == RAM_MODE) ? cart->upper : 0; 
-            write_ram(cart, ram_bank, address, value);
+            write_ram(cart, address, value);
             return;
     }
 }
@@ -320,6 +347,7 @@ static void write_ram_mbc2(Cartridge *cart, uint16_t address, uint8_t value)
     address -= EXT_RAM_START;
     address %= 0x0200;
     cart->ram[address] = value;
+    mark_ram_dirty(cart, address);
 }
 
 static uint8_t read_mbc2(Cartridge *cart, uint16_t address)
@@ -328,13 +356,11 @@ static uint8_t read_mbc2(Cartridge *cart, uint16_t address)
     {
         case 0: // $0000 - $1FFF
         case 1: // $2000 - $3FFF
-            return read_rom(cart, 0, address);
+            return read_rom0(cart, address);
         
         case 2: // $4000 - $5FFF
         case 3: // $6000 - $7FFF
-            uint8_t rom_bank = cart->lower;
-            rom_bank = (rom_bank == 0) ? 1 : rom_bank;
-            return read_rom(cart, rom_bank, (address - ROM_BANK_SIZE));
+            return read_romx(cart, address);
 
         case 4: 
             return OPEN_BUS;
@@ -361,6 +387,8 @@ static void write_mbc2(Cartridge *cart, uint16_t address, uint8_t value)
             
             value &= LOWER_4_MASK;
             cart->lower = value;
+            cart->romx_bank = ((value == 0) ? 1 : value) & cart->rom_bank_mask;
+            map_banks(cart);
             return;
        
         case 2:
@@ -390,15 +418,50 @@ static uint8_t read_rtc(Cartridge *cart, uint8_t code)
     return OPEN_BUS;
 }
 
+/*
+    The clock only advances when something observes it: a latch, a 
+    register write or a save snapshot. Elapsed dots are converted to 
+    32768 Hz oscillator ticks, whole seconds are added in one step and
+    the remainder stays in the divider.
+*/
+static void sync_rtc(Cartridge *cart)
+{
+    if (cart->cycle == NULL) return;
+
+    uint64_t ticks = (*cart->cycle - cart->rtc_cycle) / RTC_TICK_DOTS;
+    cart->rtc_cycle += ticks * RTC_TICK_DOTS;
+
+    bool halted = ((cart->clock.live_dh & BIT_6_MASK) != 0);
+
+    if (halted) 
+        return;
+
+    ticks += cart->clock.divider;
+    cart->clock.divider = (uint16_t) (ticks % RTC_FREQUENCY);
+
+    rtc_advance(cart, ticks / RTC_FREQUENCY);
+}
+
 static void write_rtc(Cartridge *cart, uint8_t code, uint8_t value)
 {
+    sync_rtc(cart); // Time up to the write runs at the old settings.
+
     switch(code)
     {
-        case 0x08: cart->clock.rtc_s  =   value % 60; break;
-        case 0x09: cart->clock.rtc_m  =   value % 60; break;
-        case 0x0A: cart->clock.rtc_h  =   value % 24; break;
-        case 0x0B: cart->clock.rtc_dl =        value; break;
-        case 0x0C: cart->clock.rtc_dh = value & 0xC1; break;
+        case 0x08: cart->clock.live_s  =   value % 60; cart->clock.divider = 0; break;
+        case 0x09: cart->clock.live_m  =   value % 60; break;
+        case 0x0A: cart->clock.live_h  =   value % 24; break;
+        case 0x0B: cart->clock.live_dl =        value; break;
+        case 0x0C: cart->clock.live_dh = value & 0xC1; break;
+    }
+
+    switch(code) // Reads see the written value until the next latch.
+    {
+        case 0x08: cart->clock.rtc_s  = cart->clock.live_s;  break;
+        case 0x09: cart->clock.rtc_m  = cart->clock.live_m;  break;
+        case 0x0A: cart->clock.rtc_h  = cart->clock.live_h;  break;
+        case 0x0B: cart->clock.rtc_dl = cart->clock.live_dl; break;
+        case 0x0C: cart->clock.rtc_dh = cart->clock.live_dh; break;
     }
 }
 
@@ -409,10 +472,13 @@ static void latch_clock(Cartridge *cart, uint8_t value)
 
     if (triggered)
     {
+        sync_rtc(cart);
+
         cart->clock. rtc_s = cart->clock. live_s;
         cart->clock. rtc_m = cart->clock. live_m;
         cart->clock. rtc_h = cart->clock. live_h;
         cart->clock.rtc_dl = cart->clock.live_dl; 
+        cart->clock.rtc_dh = cart->clock.live_dh; 
     }
 
     prev = value;
@@ -420,26 +486,21 @@ static void latch_clock(Cartridge *cart, uint8_t value)
 
 static uint8_t read_mbc3(Cartridge *cart, uint16_t address)
 {
-    uint8_t rom_bank = 0;
-
     switch(get_address_code(address))
     {
         case 0: // $0000 - $1FFF
         case 1: // $2000 - $3FFF
-            return read_rom(cart, rom_bank, address);
+            return read_rom0(cart, address);
         
         case 2: // $4000 - $5FFF
         case 3: // $6000 - $7FFF    
-            rom_bank = (cart->lower == 0) ? 1 : cart->lower;
-            return read_rom(cart, rom_bank, (address - ROM_BANK_SIZE));
+            return read_romx(cart, address);
 
         case 5: // $A000 - $BFFF
 
             if (cart->mode == RAM_MODE)
-            {
-                uint8_t bank = cart->upper;
-                return read_ram(cart, bank, address);
-            }
+                return read_ram(cart, address);
+
             // RTC_MODE
             uint8_t code = cart->upper;
             return read_rtc(cart, code);
@@ -454,15 +515,19 @@ static void write_mbc3(Cartridge *cart, uint16_t address, uint8_t value)
     {
         case 0: // $0000 - $1FFF
             cart->ram_enabled = ((value & LOWER_4_MASK) == 0x0A);
+            map_banks(cart);
             break;
 
         case 1: // $2000 - $3FFF
             cart->lower = value & LOWER_7_MASK;
+            cart->romx_bank = ((cart->lower == 0) ? 1 : cart->lower) & cart->rom_bank_mask;
+            map_banks(cart);
             break;
 
         case 2: // $4000 - $5FFF
             cart->upper = value & LOWER_4_MASK;
             cart->mode = (value > 0x07) ? RTC_MODE : RAM_MODE;
+            map_banks(cart);
             break;
         
         case 3: // $6000 - $7FFF - Latch.
@@ -475,8 +540,7 @@ static void write_mbc3(Cartridge *cart, uint16_t address, uint8_t value)
 
             if (cart->mode == RAM_MODE)
             {
-                uint8_t bank = cart->upper;
-                write_ram(cart, bank, address, value);
+                write_ram(cart, address, value);
                 return;
             }
 
@@ -495,19 +559,17 @@ static uint8_t read_mbc5(Cartridge *cart, uint16_t address)
     {
         case 0: // $0000 - $1FFF
         case 1: // $2000 - $3FFF
-            return read_rom(cart, 0, address);
+            return read_rom0(cart, address);
         
         case 2: // $4000 - $5FFF
         case 3: // $6000 - $7FFF
-            uint16_t rom_bank = (cart->mbc5_upper << 8) | cart->lower;
-            return read_rom(cart, rom_bank, (address - ROM_BANK_SIZE));
+            return read_romx(cart, address);
         
         case 4: // $8000 - $9FFF
             return OPEN_BUS;
     
         case 5: // $A000 - $BFFF
-            uint8_t ram_bank = cart->upper;
-            return read_ram(cart, ram_bank, address);
+            return read_ram(cart, address);
     }
 
     return OPEN_BUS;
@@ -520,27 +582,28 @@ static void write_mbc5(Cartridge *cart, uint16_t address, uint8_t value)
         case 0: // $0000 - $1FFF (RAM ENABLE)
 
             cart->ram_enabled = ((value & LOWER_4_MASK) == 0x0A);
+            map_banks(cart);
             return;
 
         case 1: // $2000 - $3FFF (ROM BANK SEL)
 
             if (address <= 0x2FFF)
-            {
                 cart->lower = value;
-                return;
-            }
+            else
+                cart->mbc5_upper = value & BIT_0_MASK;
 
-            cart->mbc5_upper = value & BIT_0_MASK;
+            cart->romx_bank = ((cart->mbc5_upper << 8) | cart->lower) & cart->rom_bank_mask;
+            map_banks(cart);
             return;
 
         case 2: // $4000 - $5FFF (RAM BANK SEL)
 
             cart->upper = value & LOWER_4_MASK;
+            map_banks(cart);
             return;
 
         case 5: // $A000 - $BFFF
-            uint8_t ram_bank = cart->upper;
-            write_ram(cart, ram_bank, address, value);
+            write_ram(cart, address, value);
     }
 }
 
@@ -566,10 +629,18 @@ char *get_cart_info(Cartridge *cart, char *buffer, size_t size)
 
 void load_cartridge_save(Cartridge *cart)
 {
-    if (save_file_needed(cart))
-        save_game(cart);
-    
-    load_game(cart);
+    char save_path[MAX_FILE_PATH];
+    get_save_path(cart, save_path, sizeof(save_path));
+
+    bool loaded = load_game(cart, save_path);
+
+    cart->saver = init_save_writer(save_path, cart->ram, cart->ram_size, &cart->clock, sizeof(RTCC));
+
+    if (loaded) 
+        return;
+
+    mkdir_if_needed(SAVE_DIR);
+    save_game(cart);
 }
 
 uint8_t read_cartridge(Cartridge *cart, uint16_t address)
@@ -577,50 +648,69 @@ uint8_t read_cartridge(Cartridge *cart, uint16_t address)
     return cart->cartridge_reader(cart, address);
 }
 
-void rtc_tick_day(Cartridge *cart)
+void link_cartridge(Cartridge *cart, GbcEmu *emu)
+{
+    cart->    cycle = &(emu->sched->cycle);
+    cart->rtc_cycle = emu->sched->cycle;
+}
+
+void rtc_advance(Cartridge *cart, uint64_t seconds)
 {
-    cart->clock.live_dl++;
+    RTCC *clock = &cart->clock;
+
+    bool halted = ((clock->live_dh & BIT_6_MASK) != 0);
 
-    if (cart->clock.live_dl != 0) 
+    if (halted || (seconds == 0)) 
         return;
 
-    bool upper_bit = ((cart->clock.live_dh & BIT_0_MASK) != 0);
+    uint64_t days = ((uint64_t) (clock->live_dh & BIT_0_MASK) << 8) | clock->live_dl;
+    uint64_t time = clock->live_s + (60 * clock->live_m) + (3600 * clock->live_h) + seconds;
 
-    cart->clock.live_dh = upper_bit ? (cart->clock.live_dh | BIT_7_MASK) : (cart->clock.live_dh | BIT_0_MASK);
-}
+    days += time / 86400;
+    time %= 86400;
 
-void rtc_tick_hour(Cartridge *cart)
-{
-    cart->clock.live_h = (cart->clock.live_h + 1) % 24;
+    if (days > 0x1FF) // Day counter overflow sets the sticky carry.
+    {
+        clock->live_dh |= BIT_7_MASK;
+        days &= 0x1FF;
+    }
 
-    if (cart->clock.live_h == 0) 
-        rtc_tick_day(cart);
+    clock->live_s  = (uint8_t) (time % 60);
+    clock->live_m  = (uint8_t) ((time / 60) % 60);
+    clock->live_h  = (uint8_t) (time / 3600);
+    clock->live_dl = (uint8_t) (days & 0xFF);
+    clock->live_dh = (clock->live_dh & ~BIT_0_MASK) | (uint8_t) (days >> 8);
 }
 
-void rtc_tick_minute(Cartridge *cart)
+void save_cartridge(Cartridge *cart)
 {
-    cart->clock.live_m = (cart->clock.live_m + 1) % 60;
-
-    if (cart->clock.live_m == 0) 
-        rtc_tick_hour(cart);
+    save_game(cart); // Stages and writes on the calling thread.
 }
 
-void rtc_tick_second(Cartridge *cart)
+/*
+    Snapshots run on the emulation thread, between instructions, so the
+    staged image never holds a half-written page. Without force, only 
+    dirty RAM triggers one.
+*/
+bool snapshot_cartridge_save(Cartridge *cart, bool force)
 {
-    bool halted = ((cart->clock.live_dh & BIT_6_MASK) != 0);
+    if (cart->saver == NULL) 
+        return false;
 
-    if (halted) 
-        return;
+    if (!force && !ram_dirty(cart)) 
+        return false;
 
-    cart->clock.live_s = (cart->clock.live_s + 1) % 60; 
-    
-    if (cart->clock.live_s == 0) 
-        rtc_tick_minute(cart);
+    stamp_clock(cart);
+    stage_save_pages(cart->saver, cart->ram, cart->dirty_pages, &cart->clock, sizeof(RTCC));
+    return true;
 }
 
-void save_cartridge(Cartridge *cart)
+bool flush_cartridge_save(Cartridge *cart)
 {
-    save_game(cart); // Call overhead not needed but not called often enough to matter.
+    if (cart->saver == NULL) 
+        return false;
+
+    return flush_save_writer(cart->saver);
 }
 
 void set_bios(Cartridge *cart, uint8_t value)
@@ -691,6 +781,8 @@ static void encode_cartridge(Cartridge *cart)
     cart->        lower =        1;
     cart->        upper =        0;
     cart->   mbc5_upper =        0;
+    cart->    rom0_bank =        0;
+    cart->    romx_bank = DEFAULT_ROM_BANK & cart->rom_bank_mask;
 
     cart->upper_bank_enabled = (cart->file_size >= 0x100000);
 
@@ -738,6 +830,17 @@ static void encode_cartridge(Cartridge *cart)
     }
 }
 
+static void pad_rom(Cartridge *cart)
+{
+    size_t declared = (size_t) cart->rom_bank_quantity * ROM_BANK_SIZE;
+
+    if ((size_t) cart->file_size >= declared) 
+        return;
+
+    cart->image = pad_rom_image(cart->image, declared);
+    cart->  rom = cart->image->data;
+}
+
 static void init_ram(Cartridge *cart)
 {
     cart->ram_bank_quantity = (cart->ram_bank_quantity == 0) ? 1 : cart->ram_bank_quantity;
@@ -752,15 +855,17 @@ static void init_ram(Cartridge *cart)
     }
 
     memset(cart->ram, 0, cart->ram_size);
+
+    uint32_t words = ((cart->ram_size >> SAVE_PAGE_SHIFT) + 31) >> 5;
+    cart->dirty_pages = (uint32_t*) calloc(words, sizeof(uint32_t));
 }
  
 static void init_rtcc(Cartridge *cart)
 {
-    cart-> clock.rtc_s = 0; 
-    cart-> clock.rtc_m = 0;
-    cart-> clock.rtc_h = 0;
-    cart->clock.rtc_dl = 0;
-    cart->clock.rtc_dh = 0;
+    memset(&cart->clock, 0, sizeof(RTCC));
+
+    cart->    cycle = NULL; // Until linked.
+    cart->rtc_cycle =    0;
 }
 
 Cartridge *init_cartridge(const char *file_path, const char *file_name)
@@ -774,10 +879,13 @@ Cartridge *init_cartridge(const char *file_path, const char *file_name)
     strcpy(cart->file_path, file_path);
 
     cart->      rom = get_rom_content(cart, file_path);
+    cart->    saver = NULL;
 
     encode_cartridge(cart);
+    pad_rom(cart);
     init_ram(cart);
     init_rtcc(cart);
+    map_banks(cart);
 
     return cart;
 }
@@ -791,6 +899,14 @@ void tidy_cartridge(Cartridge **cart)
     (*cart)->file_path = NULL;
     
     free((*cart)->ram); (*cart)->ram = NULL;
-    free((*cart)->rom); (*cart)->rom = NULL;
+    free((*cart)->dirty_pages);
+    (*cart)->dirty_pages = NULL;
+
+    if ((*cart)->saver != NULL) 
+        tidy_save_writer(&(*cart)->saver);
+
+    release_rom_image((*cart)->image); 
+    (*cart)->image = NULL;
+    (*cart)->  rom = NULL;
     free(*cart);               *cart = NULL;
 }
\ No newline at end of file
@@ -5,9 +5,14 @@
 #include "core/cart.h"
 #include "core/mmu.h"
 #include "core/cpu.h"
+#include "core/scheduler.h"
+#include "core/timer.h"
+#include "core/profiler.h"
 
 #include "util/common.h"
 #include "util/disassembler.h"
+#include "util/opcodes.h"
+#include "util/trace_buffer.h"
 
 typedef bool (*OpcodeHandler)(CPU*);
 
@@ -21,19 +26,95 @@ static uint16_t form_address(CPU *cpu)
     return address;
 }
 
+// Lazy Flags
+
+/*
+    The 8-bit arithmetic ops only record their operands and result. F is
+    rebuilt from them the first time something reads it (conditional 
+    branches, PUSH AF, DAA, carry-in ops or a state dump), so a result 
+    that is overwritten before it is read never costs a flag computation.
+*/
+static inline void defer_flags(CPU *cpu, FlagOp op, uint8_t lhs, uint8_t rhs, uint8_t carry, uint8_t result)
+{
+    cpu->flags.    op =     op;
+    cpu->flags.   lhs =    lhs;
+    cpu->flags.   rhs =    rhs;
+    cpu->flags. carry =  carry;
+    cpu->flags.result = result;
+}
+
+static uint8_t lazy_carry(CPU *cpu)
+{
+    LazyFlags *f = &cpu->flags;
+
+    switch(f->op)
+    {
+        case ADD_FLAGS: return ((f->lhs + f->rhs + f->carry) > LOWER_BYTE_MASK) ? 1 : 0;
+        case SUB_FLAGS: return (f->lhs < (f->rhs + f->carry)) ? 1 : 0;
+        case INC_FLAGS: 
+        case DEC_FLAGS: return f->carry;
+        default:        return ((cpu->reg.F & CARRY_FLAG) != 0) ? 1 : 0;
+    }
+}
+
+void resolve_flags(CPU *cpu)
+{
+    LazyFlags *f = &cpu->flags;
+    if (f->op == FLAGS_RESOLVED) return;
+
+    bool   is_zero = (f->result == 0);
+    bool  subtract = false;
+    bool hc_exists = false;
+
+    switch(f->op)
+    {
+        case ADD_FLAGS:
+            hc_exists = ((f->lhs & LOWER_4_MASK) + (f->rhs & LOWER_4_MASK) + f->carry) > LOWER_4_MASK;
+            break;
+
+        case SUB_FLAGS:
+            subtract  = true;
+            hc_exists = ((f->lhs & LOWER_4_MASK) < ((f->rhs & LOWER_4_MASK) + f->carry));
+            break;
+
+        case INC_FLAGS:
+            hc_exists = ((f->lhs & LOWER_4_MASK) == LOWER_4_MASK);
+            break;
+
+        case DEC_FLAGS:
+            subtract  = true;
+            hc_exists = ((f->lhs & LOWER_4_MASK) == 0);
+            break;
+
+        default: 
+            break;
+    }
+
+    cpu->reg.F = (is_zero   ? ZERO_FLAG       : 0) |
+                 (subtract  ? SUBTRACT_FLAG   : 0) |
+                 (hc_exists ? HALF_CARRY_FLAG : 0) |
+                 (lazy_carry(cpu) ? CARRY_FLAG : 0);
+    f->op = FLAGS_RESOLVED;
+}
+
 static void write_flag_reg(CPU *cpu, uint8_t value)
 {
     cpu->reg.F = (value & 0xF0); // Only the upper nibble.
+    cpu->flags.op = FLAGS_RESOLVED;
 }
 
 static void set_flag(CPU *cpu, bool is_set, Flag flag_mask)
 {
+    resolve_flags(cpu);
     uint8_t value = is_set ? (cpu->reg.F | flag_mask) : (cpu->reg.F & ~flag_mask);
     write_flag_reg(cpu, value);
 }
 
 static bool is_flag_set(CPU *cpu, Flag flag)
 {
+    if (flag == CARRY_FLAG) return (lazy_carry(cpu) != 0); // Carry alone is cheap to derive.
+
+    resolve_flags(cpu);
     return ((cpu->reg.F & flag) != 0);
 }
 
@@ -46,6 +127,13 @@ static uint8_t fetch(CPU *cpu)
         cpu->halt_bug_active = false;
         rom_byte = read_memory(cpu->mem, cpu->reg.PC);
     }
+    else if (cpu->ins.decoded != NULL) // Served from the decode cache.
+    {
+        uint16_t offset = cpu->reg.PC - cpu->ins.address;
+        rom_byte = (offset < cpu->ins.decoded->length) ? 
+        cpu->ins.decoded->bytes[offset] : read_memory(cpu->mem, cpu->reg.PC);
+        cpu->reg.PC++;
+    }
     else
     {
         rom_byte = read_memory(cpu->mem, cpu->reg.PC++);
@@ -58,7 +146,7 @@ static uint16_t getDR(CPU *cpu, DualRegister dr)
 {
     switch(dr)
     {
-        case AF_REG: return (uint16_t)((cpu->reg.A << BYTE) | cpu->reg.F);
+        case AF_REG: resolve_flags(cpu); return (uint16_t)((cpu->reg.A << BYTE) | cpu->reg.F);
         case BC_REG: return (uint16_t)((cpu->reg.B << BYTE) | cpu->reg.C);
         case DE_REG: return (uint16_t)((cpu->reg.D << BYTE) | cpu->reg.E);
         case HL_REG: return (uint16_t)((cpu->reg.H << BYTE) | cpu->reg.L);
@@ -74,7 +162,7 @@ static void setDR(CPU *cpu, DualRegister dr, uint16_t source)
     {
         case AF_REG:
             cpu->reg.A = ((uint8_t) (source >> BYTE));
-            cpu->reg.F = ((uint8_t) (source & 0xF0));            
+            write_flag_reg(cpu, (uint8_t) source);
             break;
         case BC_REG:
             cpu->reg.B = ((uint8_t) (source >> BYTE));
@@ -159,6 +247,13 @@ static uint8_t get_pending_interrupts(CPU *cpu)
     return ifr & ier;
 }
 
+static const char *get_ins_label(CPU *cpu)
+{
+    if (cpu->ins.slot == INTERRUPT_SLOT) return cpu->ins.label;
+
+    return (cpu->ins.slot >= PREFIX_SLOT) ? cb_opcode_word[cpu->ins.opcode] : opcode_word[cpu->ins.opcode];
+}
+
 char *get_cpu_state(CPU *cpu, char *buffer, size_t size)
 {
     snprintf(
@@ -172,7 +267,7 @@ char *get_cpu_state(CPU *cpu, char *buffer, size_t size)
         (*cpu->reg.IFR),
         get_pending_interrupts(cpu), 
         cpu->ins.opcode, 
-        cpu->ins.label
+        get_ins_label(cpu)
     );
     
     return buffer;
@@ -180,11 +275,13 @@ char *get_cpu_state(CPU *cpu, char *buffer, size_t size)
 
 char *get_reg_state(CPU *cpu, char *buffer, size_t size)
 {
+    resolve_flags(cpu);
+
     snprintf(
         buffer,
         size,
         "[%d] A-$%02X%02X-F || B-$%02X%02X-C || D-$%02X%02X-E || H-$%02X%02X-L [PC=%04X] [SP=%04X] $%02X- %-17s",
-        cpu->ime, cpu->reg.A, cpu->reg.F, cpu->reg.B, cpu->reg.C, cpu->reg.D, cpu->reg.E, cpu->reg.H, cpu->reg.L, cpu->reg.PC, cpu->reg.SP, cpu->ins.opcode, cpu->ins.label
+        cpu->ime, cpu->reg.A, cpu->reg.F, cpu->reg.B, cpu->reg.C, cpu->reg.D, cpu->reg.E, cpu->reg.H, cpu->reg.L, cpu->reg.PC, cpu->reg.SP, cpu->ins.opcode, get_ins_label(cpu)
     );
 
     return buffer;
@@ -557,6 +654,7 @@ static bool push_af(CPU *cpu)    // 0xF5 (- - - -) 4M
             push_stack(cpu, cpu->reg.A);
             return false;
         case 4:
+            resolve_flags(cpu);
             push_stack(cpu, cpu->reg.F);
             return true; // Instruction Complete
     }
@@ -1148,11 +1246,7 @@ static bool ld_a_n(CPU *cpu)     // 0x3E (- - - -) 2M
 static uint8_t reg_inc_8(CPU *cpu, uint8_t r)
 {
     uint8_t result = r + 1;
-    bool   is_zero = (result == 0);
-    bool hc_exists = ((r & LOWER_4_MASK) == LOWER_4_MASK);
-    set_flag(cpu, is_zero, ZERO_FLAG);
-    set_flag(cpu, false, SUBTRACT_FLAG);
-    set_flag(cpu, hc_exists, HALF_CARRY_FLAG);
+    defer_flags(cpu, INC_FLAGS, r, 1, lazy_carry(cpu), result);
     return result;
 }
 static bool inc_b(CPU *cpu)      // 0x04 (Z 0 H -) 1M
@@ -1215,11 +1309,7 @@ static bool inc_a(CPU *cpu)      // 0x3C (Z 0 H -) 1M
 static uint8_t reg_dec_8(CPU *cpu, uint8_t r)
 {
     uint8_t result = r - 1;
-    bool   is_zero = (result == 0);
-    bool hc_exists = ((r & LOWER_4_MASK) == 0);
-    set_flag(cpu, is_zero, ZERO_FLAG);
-    set_flag(cpu, true, SUBTRACT_FLAG);
-    set_flag(cpu, hc_exists, HALF_CARRY_FLAG);
+    defer_flags(cpu, DEC_FLAGS, r, 1, lazy_carry(cpu), result);
     return result;
 }
 static bool dec_b(CPU *cpu)      // 0x05 (Z 1 H -) 1M
@@ -1369,13 +1459,7 @@ static bool add_hl_sp(CPU *cpu)  // 0x39 (- 0 H C) 2M
 static uint8_t reg_add_8(CPU *cpu, uint8_t dest, uint8_t source)
 { // 0x8X
     uint8_t  result = dest + source;
-    bool    is_zero = (result == 0);
-    bool  hc_exists = ((dest & LOWER_4_MASK) + (source & LOWER_4_MASK)) > LOWER_4_MASK;
-    bool   c_exists = (((uint16_t) dest) + ((uint16_t) source)) > LOWER_BYTE_MASK;
-    set_flag(cpu, is_zero, ZERO_FLAG);
-    set_flag(cpu, false, SUBTRACT_FLAG);
-    set_flag(cpu, hc_exists, HALF_CARRY_FLAG);
-    set_flag(cpu, c_exists, CARRY_FLAG);
+    defer_flags(cpu, ADD_FLAGS, dest, source, 0, result);
     return (uint8_t) result;
 }
 static bool add_a_b(CPU *cpu)    // 0x80 (Z 0 H C) 1M
@@ -1446,15 +1530,9 @@ static bool add_a_n(CPU *cpu)    // 0xC6 (Z 0 H C) 2M
 
 static uint8_t reg_adc_8(CPU *cpu, uint8_t dest, uint8_t source)
 { // 0x8X
-    uint8_t  carry = is_flag_set(cpu, CARRY_FLAG) ? 1 : 0;
+    uint8_t  carry = lazy_carry(cpu);
     uint8_t result = dest + source + carry;
-    bool is_zero   = (result  == 0);
-    bool hc_exists = ((dest & LOWER_4_MASK) + (source & LOWER_4_MASK) + carry) > LOWER_4_MASK;
-    bool c_exists  = (((uint16_t) dest) + ((uint16_t) source) + ((uint16_t) carry)) > LOWER_BYTE_MASK;
-    set_flag(cpu, is_zero, ZERO_FLAG);
-    set_flag(cpu, false, SUBTRACT_FLAG);
-    set_flag(cpu, hc_exists, HALF_CARRY_FLAG);
-    set_flag(cpu, c_exists, CARRY_FLAG);
+    defer_flags(cpu, ADD_FLAGS, dest, source, carry, result);
     return (uint8_t) result;
 }
 static bool adc_a_b(CPU *cpu)    // 0x88 (Z 0 H C) 1M
@@ -1526,13 +1604,7 @@ static bool adc_a_n(CPU *cpu)    // 0xCE (Z 0 H C) 2M
 static uint8_t reg_sub_8(CPU *cpu, uint8_t dest, uint8_t source)
 {
     uint8_t result = (dest - source);
-    bool    is_zero = (result == 0);
-    bool  hc_exists = ((dest & LOWER_4_MASK) < (source & LOWER_4_MASK));
-    bool   c_exists = dest < source;
-    set_flag(cpu, is_zero, ZERO_FLAG);
-    set_flag(cpu, true, SUBTRACT_FLAG);
-    set_flag(cpu, hc_exists, HALF_CARRY_FLAG);
-    set_flag(cpu, c_exists, CARRY_FLAG);
+    defer_flags(cpu, SUB_FLAGS, dest, source, 0, result);
     return (uint8_t) result;
 }
 static bool sub_a_b(CPU *cpu)    // 0x90 (Z 1 H C) 1M
@@ -1603,15 +1675,9 @@ static bool sub_a_n(CPU *cpu)    // 0xD6 (Z 1 H C) 2M
 
 static uint8_t reg_sbc_8(CPU *cpu, uint8_t dest, uint8_t source)
 {
-    uint8_t   carry = is_flag_set(cpu, CARRY_FLAG) ? 1 : 0;
+    uint8_t   carry = lazy_carry(cpu);
     uint8_t  result = (dest - source - carry);
-    bool    is_zero = (result == 0);
-    bool  hc_exists = ((dest & LOWER_4_MASK) < ((source & LOWER_4_MASK) + carry));
-    bool   c_exists = dest < (source + carry);
-    set_flag(cpu, is_zero, ZERO_FLAG);
-    set_flag(cpu, true, SUBTRACT_FLAG);
-    set_flag(cpu, hc_exists, HALF_CARRY_FLAG);
-    set_flag(cpu, c_exists, CARRY_FLAG);
+    defer_flags(cpu, SUB_FLAGS, dest, source, carry, result);
     return (uint8_t) result;
 }
 static bool sbc_a_b(CPU *cpu)    // 0x98 (Z 1 H C) 1M
@@ -1683,11 +1749,7 @@ static bool sbc_a_n(CPU *cpu)    // 0xDE (Z 1 H C) 2M
 static uint8_t reg_and_8(CPU *cpu, uint8_t dest, uint8_t source)
 {
     uint8_t result = dest & source;
-    bool   is_zero = (result == 0);
-    set_flag(cpu, is_zero, ZERO_FLAG);
-    set_flag(cpu, false, SUBTRACT_FLAG);
-    set_flag(cpu, true, HALF_CARRY_FLAG);
-    set_flag(cpu, false, CARRY_FLAG);
+    write_flag_reg(cpu, ((result == 0) ? ZERO_FLAG : 0) | HALF_CARRY_FLAG);
     return result;
 }
 static bool and_a_b(CPU *cpu)    // 0xA0 (Z 0 1 0) 1M
@@ -1759,11 +1821,7 @@ static bool and_a_n(CPU *cpu)    // 0xE6 (Z 0 1 0) 2M
 static uint8_t reg_xor_8(CPU *cpu, uint8_t dest, uint8_t source)
 {
     uint8_t result = dest ^ source;
-    bool   is_zero = (result == 0);
-    set_flag(cpu, is_zero, ZERO_FLAG);
-    set_flag(cpu, false, SUBTRACT_FLAG);
-    set_flag(cpu, false, HALF_CARRY_FLAG);
-    set_flag(cpu, false, CARRY_FLAG);
+    write_flag_reg(cpu, (result == 0) ? ZERO_FLAG : 0);
     return result;
 }
 static bool xor_a_b(CPU *cpu)    // 0xA8 (Z 0 0 0) 1M
@@ -1835,11 +1893,7 @@ static bool xor_a_n(CPU *cpu)    // 0xEE (Z 0 0 0) 2M
 static uint8_t reg_or_8(CPU *cpu, uint8_t dest, uint8_t source)
 {
     uint8_t result = dest | source;
-    bool   is_zero = (result == 0);
-    set_flag(cpu, is_zero, ZERO_FLAG);
-    set_flag(cpu, false, SUBTRACT_FLAG);
-    set_flag(cpu, false, HALF_CARRY_FLAG);
-    set_flag(cpu, false, CARRY_FLAG);
+    write_flag_reg(cpu, (result == 0) ? ZERO_FLAG : 0);
     return result;
 }
 static bool or_a_b(CPU *cpu)     // 0xB0 (Z 0 0 0) 1M
@@ -1910,13 +1964,7 @@ static bool or_a_n(CPU *cpu)     // 0xF6 (Z 0 0 0) 2M
 
 static void reg_cp_8(CPU *cpu, uint8_t dest, uint8_t source)
 {
-    bool    is_zero = (dest == source); 
-    bool  hc_exists = ((dest & LOWER_4_MASK) < (source & LOWER_4_MASK));
-    bool   c_exists = dest < source;
-    set_flag(cpu, is_zero, ZERO_FLAG);
-    set_flag(cpu, true, SUBTRACT_FLAG);
-    set_flag(cpu, hc_exists, HALF_CARRY_FLAG);
-    set_flag(cpu, c_exists, CARRY_FLAG);
+    defer_flags(cpu, SUB_FLAGS, dest, source, 0, (uint8_t) (dest - source));
 }
 static bool cp_a_b(CPU *cpu)     // 0xB8 (Z 1 H C) 1M
 {
@@ -4952,9 +5000,355 @@ static void reset_ins(CPU *cpu)
     cpu->ins.     low =           0;
     cpu->ins.    high =           0;
     cpu->ins.  opcode =           0;
-    cpu->ins.   label =       "N/A";
     cpu->ins.executed =       false;
     cpu->ins. handler =         nop;
+    cpu->ins. decoded =        NULL;
+    cpu->ins.    slot =           0;
+}
+
+// Decode Cache
+
+static const uint8_t opcode_length[256] = 
+{
+ // x0 x1 x2 x3 x4 x5 x6 x7 x8 x9 xA xB xC xD xE xF
+    1, 3, 1, 1, 1, 1, 2, 1, 3, 1, 1, 1, 1, 1, 2, 1, // 0x
+    2, 3, 1, 1, 1, 1, 2, 1, 2, 1, 1, 1, 1, 1, 2, 1, // 1x
+    2, 3, 1, 1, 1, 1, 2, 1, 2, 1, 1, 1, 1, 1, 2, 1, // 2x
+    2, 3, 1, 1, 1, 1, 2, 1, 2, 1, 1, 1, 1, 1, 2, 1, // 3x
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 4x
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 5x
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 6x
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 7x
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 8x
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 9x
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // Ax
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // Bx
+    1, 1, 3, 3, 3, 1, 2, 1, 1, 1, 3, 1, 3, 3, 2, 1, // Cx
+    1, 1, 3, 1, 3, 1, 2, 1, 1, 1, 3, 1, 3, 1, 2, 1, // Dx
+    2, 1, 1, 1, 1, 1, 2, 1, 2, 1, 3, 1, 1, 1, 2, 1, // Ex
+    2, 1, 1, 1, 1, 1, 2, 1, 2, 1, 3, 1, 1, 1, 2, 1  // Fx
+};
+
+static bool ends_block(uint8_t opcode)
+{
+    switch(opcode)
+    {
+        case JR_N:     case JR_NZ_N:   case JR_Z_N:    case JR_NC_N:   case JR_C_N:
+        case JP_NN:    case JP_NZ_NN:  case JP_Z_NN:   case JP_NC_NN:  case JP_C_NN:   case JP_HL:
+        case CALL_NN:  case CALL_NZ_NN: case CALL_Z_NN: case CALL_NC_NN: case CALL_C_NN:
+        case RET:      case RET_NZ:    case RET_Z:     case RET_NC:    case RET_C:     case RETI:
+        case RST_00H:  case RST_08H:   case RST_10H:   case RST_18H:
+        case RST_20H:  case RST_28H:   case RST_30H:   case RST_38H:
+        case HALT:     case STOP:
+            return true;
+    }
+
+    return false;
+}
+
+/*
+    Only ROM, WRAM and HRAM hold cacheable code. ROM blocks carry the 
+    cartridge bank register they were decoded under, RAM blocks are 
+    dropped wholesale when anything writes over them.
+*/
+static bool code_region(CPU *cpu, uint16_t address, uint16_t *bank, const uint16_t **live_bank, uint16_t *end)
+{
+    if (address <= ROM_STATIC_END)
+    {
+        *live_bank = &cpu->cart->rom0_bank;
+        *end       = ROM_STATIC_END;
+    }
+    else if (address <= ROM_DYNAMIC_END)
+    {
+        *live_bank = &cpu->cart->romx_bank;
+        *end       = ROM_DYNAMIC_END;
+    }
+    else if ((address >= WRAM_STATIC_START) && (address <= WRAM_STATIC_END))
+    {
+        *live_bank = NULL;
+        *end       = WRAM_STATIC_END;
+    }
+    else if ((address >= WRAM_DYNAMIC_START) && (address <= WRAM_DYNAMIC_END))
+    {
+        *live_bank = NULL;
+        *end       = WRAM_DYNAMIC_END;
+    }
+    else if ((address >= HIGH_RAM_START) && (address <= HIGH_RAM_END))
+    {
+        *live_bank = NULL;
+        *end       = HIGH_RAM_END;
+    }
+    else
+    {
+        return false;
+    }
+
+    *bank = (*live_bank != NULL) ? **live_bank : 0;
+    return true;
+}
+
+static inline uint16_t block_slot(uint16_t address, uint16_t bank)
+{
+    uint32_t hash = (address ^ ((uint32_t) bank << 7)) * 0x9E3779B1u;
+    return (hash >> 16) & (BLOCK_CACHE_SIZE - 1);
+}
+
+static bool register_only(DecodedInstruction *entry)
+{
+    uint8_t opcode = entry->opcode;
+
+    if (entry->cb_prefixed)
+        return ((opcode & LOWER_3_MASK) != 0x06); // (HL) operand
+
+    if ((opcode >= LD_B_B) && (opcode <= CP_A_A))
+        return ((opcode & LOWER_3_MASK) != 0x06) && ((opcode < LD_HL_B) || (opcode > LD_HL_A));
+
+    switch(opcode)
+    {
+        case NOP:
+        case LD_BC_NN:  case LD_DE_NN:  case LD_HL_NN:  case LD_SP_NN:
+        case INC_BC:    case INC_DE:    case INC_HL:    case INC_SP:
+        case DEC_BC:    case DEC_DE:    case DEC_HL:    case DEC_SP:
+        case INC_B:     case INC_C:     case INC_D:     case INC_E:     case INC_H:   case INC_L:   case INC_A:
+        case DEC_B:     case DEC_C:     case DEC_D:     case DEC_E:     case DEC_H:   case DEC_L:   case DEC_A:
+        case LD_B_N:    case LD_C_N:    case LD_D_N:    case LD_E_N:    case LD_H_N:  case LD_L_N:  case LD_A_N:
+        case ADD_HL_BC: case ADD_HL_DE: case ADD_HL_HL: case ADD_HL_SP:
+        case RLCA:      case RRCA:      case RLA:       case RRA:
+        case DAA:       case CPL:       case SCF:       case CCF:
+        case ADD_A_N:   case ADC_A_N:   case SUB_A_N:   case SBC_A_N:
+        case AND_A_N:   case XOR_A_N:   case OR_A_N:    case CP_A_N:
+        case JR_N:      case JR_NZ_N:   case JR_Z_N:    case JR_NC_N:   case JR_C_N:
+        case JP_NN:     case JP_NZ_NN:  case JP_Z_NN:   case JP_NC_NN:  case JP_C_NN: case JP_HL:
+        case LD_SP_HL:  case ADD_SP_N:  case LD_HL_SP_N:
+            return true;
+    }
+
+    return false;
+}
+
+static uint8_t count_register_only(CodeBlock *block)
+{
+    uint8_t count = 0;
+
+    while (count < block->count)
+    {
+        DecodedInstruction *entry = &block->ins[count];
+
+        if (!entry->cb_prefixed && (entry->opcode == CB_PREFIX))
+        {
+            if (((count + 1) >= block->count) || !register_only(&block->ins[count + 1])) break;
+            count += 2;
+            continue;
+        }
+
+        if (!register_only(entry)) break;
+        count++;
+    }
+
+    return count;
+}
+
+static void decode_block(CPU *cpu, CodeBlock *block, uint16_t start, uint16_t bank, const uint16_t *live_bank, uint16_t end)
+{
+    if (block->valid && (block->live_bank == NULL))
+        cpu->ram_blocks--;
+
+    block->    start = start;
+    block->     bank = bank;
+    block->live_bank = live_bank;
+    block->    count = 0;
+    block->    valid = true;
+
+    if (live_bank == NULL)
+        cpu->ram_blocks++;
+
+    uint32_t address = start;
+    bool    prefixed = cpu->ins.cb_prefixed;
+
+    while (block->count < MAX_BLOCK_LENGTH)
+    {
+        uint8_t opcode = read_memory(cpu->mem, address);
+        uint8_t length = prefixed ? 1 : opcode_length[opcode];
+
+        if ((address + length - 1) > end) break;
+
+        // Keep a prefix and its operation in the same block.
+        if (!prefixed && (opcode == CB_PREFIX) && (block->count == (MAX_BLOCK_LENGTH - 1))) break;
+
+        DecodedInstruction *entry = &block->ins[block->count++];
+
+        entry->    address = address;
+        entry->     opcode = opcode;
+        entry->     length = length;
+        entry->cb_prefixed = prefixed;
+        entry->    handler = prefixed ? prefix_opcode_table[opcode] : opcode_table[opcode];
+
+        for (uint8_t i = 0; i < length; i++)
+        {
+            entry->bytes[i] = read_memory(cpu->mem, (address + i));
+
+            if (live_bank == NULL)
+                mark_ram_code(cpu->mem, (address + i));
+        }
+
+        address += length;
+
+        if (!prefixed && ends_block(opcode)) break;
+
+        prefixed = !prefixed && (opcode == CB_PREFIX);
+    }
+
+    block->register_count = count_register_only(block);
+}
+
+static const DecodedInstruction *lookup_decoded(CPU *cpu)
+{
+    if (cpu->halt_bug_active) return NULL; // Opcode is read twice, decode it live.
+
+    uint16_t    pc = cpu->reg.PC;
+    CodeBlock *block = cpu->block;
+
+    // Fall through to the next instruction of the running block.
+    if ((block != NULL) && (cpu->block_next < block->count))
+    {
+        const DecodedInstruction *entry = &block->ins[cpu->block_next];
+
+        if ((entry->address == pc) && (entry->cb_prefixed == cpu->ins.cb_prefixed) &&
+            ((block->live_bank == NULL) || (*block->live_bank == block->bank)))
+        {
+            cpu->block_next++;
+            return entry;
+        }
+    }
+
+    cpu->block = NULL;
+
+    uint16_t bank = 0, end = 0;
+    const uint16_t *live_bank = NULL;
+
+    if (!code_region(cpu, pc, &bank, &live_bank, &end)) 
+        return NULL;
+
+    block = &cpu->blocks[block_slot(pc, bank)];
+
+    if (!block->valid || (block->start != pc) || (block->bank != bank) || (block->live_bank != live_bank))
+        decode_block(cpu, block, pc, bank, live_bank, end);
+
+    if ((block->count == 0) || (block->ins[0].cb_prefixed != cpu->ins.cb_prefixed)) 
+        return NULL;
+
+    cpu->     block = block;
+    cpu->block_next = 1;
+
+    return &block->ins[0];
+}
+
+void flush_ram_code(CPU *cpu)
+{
+    if (cpu->ram_blocks == 0) return;
+
+    for (int i = 0; i < BLOCK_CACHE_SIZE; i++)
+    {
+        if (cpu->blocks[i].valid && (cpu->blocks[i].live_bank == NULL))
+            cpu->blocks[i].valid = false;
+    }
+
+    clear_ram_code(cpu->mem);
+
+    cpu->ram_blocks = 0;
+    cpu->     block = NULL;
+}
+
+// Execution Trace
+
+#if TRACE_SUPPORT || PROFILE_SUPPORT
+
+static uint16_t code_bank(CPU *cpu, uint16_t address)
+{
+    if (address <= ROM_STATIC_END)  return cpu->cart->rom0_bank;
+    if (address <= ROM_DYNAMIC_END) return cpu->cart->romx_bank;
+
+    if ((address >= WRAM_DYNAMIC_START) && (address <= WRAM_DYNAMIC_END))
+        return cpu->mem->memory[SVBK] & LOWER_3_MASK;
+
+    return 0;
+}
+
+#endif
+
+#if TRACE_SUPPORT
+
+static void trace_ins(CPU *cpu, TraceKind kind, uint16_t address)
+{
+    TraceBuffer  *trace = cpu->trace;
+    TraceRecord *record = trace_buffer_claim(trace);
+    if (record == NULL) return; // Full, counted as dropped.
+
+    resolve_flags(cpu);
+
+    record->cycle = cpu->sched->cycle;
+    record->   pc = address;
+    record-> bank = code_bank(cpu, address);
+    record->   sp = cpu->reg.SP;
+    record-> kind = kind;
+
+    record->A = cpu->reg.A; record->F = cpu->reg.F;
+    record->B = cpu->reg.B; record->C = cpu->reg.C;
+    record->D = cpu->reg.D; record->E = cpu->reg.E;
+    record->H = cpu->reg.H; record->L = cpu->reg.L;
+
+    memset(record->bytes, 0, sizeof(record->bytes));
+
+    if (kind == TRACE_INTERRUPT)
+    {
+        record->bytes[0] = cpu->ins.low; // Interrupt code.
+    }
+    else
+    {
+        uint8_t opcode = read_memory(cpu->mem, address);
+        uint8_t length = (opcode == CB_PREFIX) ? 2 : opcode_length[opcode];
+
+        for (uint8_t i = 0; i < length; i++)
+            record->bytes[i] = (i == 0) ? opcode : read_memory(cpu->mem, (address + i));
+    }
+
+    trace_buffer_commit(trace);
+}
+
+#endif
+
+// Profiling
+
+#if PROFILE_SUPPORT
+
+static inline void profile_location(CPU *cpu, uint16_t address)
+{
+    cpu->profile_index = profile_index(cpu->profiler, address, code_bank(cpu, address));
+}
+
+static void profile_machine_cycle(CPU *cpu)
+{
+    if (!cpu->running) return;
+
+    if (cpu->halted)
+    {
+        cpu->profiler->halted_cycles++;
+        return;
+    }
+
+    profile_cycle(cpu->profiler, cpu->profile_index, cpu->ins.slot);
+}
+
+#endif
+
+void attach_profiler(CPU *cpu, Profiler *profiler)
+{
+#if PROFILE_SUPPORT
+    cpu->profiler = profiler;
+    if (profiler != NULL) profile_location(cpu, cpu->reg.PC);
+#else
+    cpu->profiler = NULL;
+#endif
 }
 
 // Interrupt Handling
@@ -4973,8 +5367,261 @@ static bool service_interrupts(CPU *cpu)
     cpu->ime = false;
     reset_ins(cpu); // Normalize
     cpu->ins.handler = int_exec;
+    cpu->ins.   slot = INTERRUPT_SLOT;
     encode_interrupt(cpu, pending);
 
+#if TRACE_SUPPORT
+    if (cpu->trace != NULL) trace_ins(cpu, TRACE_INTERRUPT, cpu->ins.address);
+#endif
+
+#if PROFILE_SUPPORT
+    if (cpu->profiler != NULL) profile_location(cpu, cpu->ins.address);
+#endif
+
+    return true;
+}
+
+// Idle Loop Detection
+
+/*
+    Polling loops such as "LDH A,[LY] / CP n / JR NZ" repeat the exact same
+    CPU state every iteration until the polled register changes. Once the
+    body is known to be register-only apart from a single PPU or timer 
+    read, one iteration is recorded cycle by cycle. Later iterations are
+    absorbed, re-reading only the polled register on its own cycle, and 
+    the recorded state for the current cycle is restored on exit.
+*/
+static bool idle_register(uint16_t address)
+{
+    return ((address >= DIV) && (address <= TAC)) || ((address >= LCDC) && (address <= WX));
+}
+
+static bool idle_code(uint16_t address)
+{
+    return (address < VRAM_START) || ((address >= WRAM_STATIC_START) && (address < ECHO_RAM_START)) || (address >= HIGH_RAM_START);
+}
+
+static bool loop_branch(uint16_t slot)
+{
+    switch(slot)
+    {
+        case JR_NZ_N:  case JR_Z_N:  case JR_NC_N:  case JR_C_N:
+        case JP_NZ_NN: case JP_Z_NN: case JP_NC_NN: case JP_C_NN:
+            return true;
+    }
+
+    return false;
+}
+
+static bool scan_idle_loop(CPU *cpu, uint16_t head, uint16_t end)
+{
+    IdleLoop *spin = &cpu->spin;
+
+    bool     polled = false;
+    uint16_t  index = head;
+
+    if (!idle_code(head) || !idle_code(end - 1) || ((end - head) > MAX_SPIN_BYTES)) 
+        return false;
+
+    while (index < end)
+    {
+        DecodedInstruction entry = { .opcode = read_memory(cpu->mem, index), .cb_prefixed = false };
+        uint8_t           length = opcode_length[entry.opcode];
+        uint16_t         address = 0;
+
+        switch(entry.opcode)
+        {
+            case LDH_A_N: 
+                address = 0xFF00 | read_memory(cpu->mem, index + 1);   
+                spin->poll_step = 3; 
+                break;
+
+            case LDH_A_C: 
+                address = 0xFF00 | cpu->reg.C;
+                spin->poll_step = 2; 
+                break;
+
+            case LD_A_NN: 
+                address = (read_memory(cpu->mem, index + 2) << BYTE) | read_memory(cpu->mem, index + 1);
+                spin->poll_step = 4; 
+                break;
+
+            case CB_PREFIX:
+                entry.opcode      = read_memory(cpu->mem, index + 1);
+                entry.cb_prefixed = true;
+                length            = 2;
+                if (!register_only(&entry)) return false;
+                break;
+
+            default:
+                if (!register_only(&entry)) return false;
+                break;
+        }
+
+        if (address != 0)
+        {
+            if (polled || !idle_register(address)) return false;
+
+            polled             = true;
+            spin->poll_address = address;
+            spin->poll_opcode  = entry.opcode;
+            spin->poll_pc      = index + length;
+        }
+
+        index += length;
+    }
+
+    return polled && (index == end);
+}
+
+static void watch_idle_loop(CPU *cpu) // The retiring instruction is a taken backward branch.
+{
+    IdleLoop *spin = &cpu->spin;
+    uint16_t  head = cpu->reg.PC;
+    uint16_t   end = cpu->ins.address + opcode_length[cpu->ins.opcode];
+
+    if ((spin->state != SPIN_OFF) && (spin->head == head) && (spin->end == end)) return;
+
+    spin->state = SPIN_OFF;
+    if ((cpu->trace != NULL) || (cpu->profiler != NULL)) return; // Traces and profiles see every iteration.
+    if (!scan_idle_loop(cpu, head, end)) return;
+
+    spin->head  = head;
+    spin->end   = end;
+    spin->state = SPIN_ARMED;
+}
+
+static void save_spin_frame(CPU *cpu, SpinFrame *frame)
+{
+    frame->        reg = cpu->reg;
+    frame->      flags = cpu->flags;
+    frame->        ins = cpu->ins;
+    frame->      block = cpu->block;
+    frame-> block_next = cpu->block_next;
+    frame->idle_cycles = cpu->idle_cycles;
+}
+
+static void load_spin_frame(CPU *cpu, SpinFrame *frame)
+{
+    cpu->        reg = frame->reg;
+    cpu->      flags = frame->flags;
+    cpu->        ins = frame->ins;
+    cpu->      block = frame->block;
+    cpu-> block_next = frame->block_next;
+    cpu->idle_cycles = frame->idle_cycles;
+}
+
+static bool same_spin_frame(SpinFrame *a, SpinFrame *b)
+{
+    Register          *x = &a->reg, *y = &b->reg;
+    InstructionEntity *i = &a->ins, *j = &b->ins;
+
+    bool registers = (x->A == y->A) && (x->F == y->F) && (x->B == y->B) && (x->C == y->C) && 
+                     (x->D == y->D) && (x->E == y->E) && (x->H == y->H) && (x->L == y->L) && 
+                     (x->PC == y->PC) && (x->SP == y->SP);
+
+    bool instruction = (i->opcode == j->opcode) && (i->duration == j->duration) && (i->address == j->address) && 
+                       (i->low == j->low) && (i->high == j->high) && (i->decoded == j->decoded);
+
+    return registers && instruction && (a->block == b->block) && 
+    (a->block_next == b->block_next) && (a->idle_cycles == b->idle_cycles);
+}
+
+static bool at_poll_step(CPU *cpu)
+{
+    IdleLoop *spin = &cpu->spin;
+
+    return (cpu->ins.slot == spin->poll_opcode) && (cpu->reg.PC == spin->poll_pc) && 
+    !cpu->ins.executed && (cpu->ins.duration == (spin->poll_step - 1)) && (cpu->idle_cycles == 0);
+}
+
+static void start_recording(CPU *cpu)
+{
+    IdleLoop *spin = &cpu->spin;
+
+    resolve_flags(cpu);
+    save_spin_frame(cpu, &spin->frames[0]);
+
+    spin->value  = read_memory(cpu->mem, spin->poll_address);
+    spin->length = 1;
+    spin->state  = SPIN_RECORDING;
+}
+
+static void stop_spin(CPU *cpu)
+{
+    IdleLoop *spin = &cpu->spin;
+
+    if (spin->state == SPIN_ACTIVE)
+        load_spin_frame(cpu, &spin->frames[spin->offset]);
+
+    spin->state = SPIN_OFF;
+}
+
+static bool spin_cycle(CPU *cpu) // Returns true when the cycle was absorbed.
+{
+    IdleLoop *spin = &cpu->spin;
+
+    switch(spin->state)
+    {
+        case SPIN_OFF:
+            return false;
+
+        case SPIN_ARMED:
+            if ((cpu->reg.PC < spin->head) || (cpu->reg.PC > spin->end))
+                spin->state = SPIN_OFF;
+            else if (at_poll_step(cpu) && !cpu->ime_scheduled)
+                start_recording(cpu);
+            return false;
+
+        case SPIN_RECORDING:
+            if ((cpu->reg.PC < spin->head) || (cpu->reg.PC > spin->end) || cpu->ime_scheduled)
+            {
+                spin->state = SPIN_OFF;
+                return false;
+            }
+
+            if (at_poll_step(cpu))
+            {
+                SpinFrame current;
+                resolve_flags(cpu);
+                save_spin_frame(cpu, &current);
+
+                if (!same_spin_frame(&current, &spin->frames[0]) || (read_memory(cpu->mem, spin->poll_address) != spin->value))
+                {
+                    start_recording(cpu); // Not settled yet, try again from here.
+                    return false;
+                }
+
+                spin->offset = 0;
+                spin->state  = SPIN_ACTIVE;
+                break;
+            }
+
+            if (spin->length == MAX_SPIN_CYCLES)
+            {
+                spin->state = SPIN_OFF;
+                return false;
+            }
+
+            save_spin_frame(cpu, &spin->frames[spin->length++]);
+            return false;
+
+        case SPIN_ACTIVE:
+            break;
+    }
+
+    // Absorbing
+
+    bool interrupted = cpu->ime && (get_pending_interrupts(cpu) != 0);
+    bool     changed = (spin->offset == 0) && (read_memory(cpu->mem, spin->poll_address) != spin->value);
+
+    if (interrupted || changed)
+    {
+        stop_spin(cpu); // Resume on this cycle as if every iteration had run.
+        return false;
+    }
+
+    spin->offset = ((spin->offset + 1) == spin->length) ? 0 : (spin->offset + 1);
     return true;
 }
 
@@ -4991,19 +5638,76 @@ static void check_pending_interrupts(CPU *cpu)
 
 static void next_ins(CPU *cpu)
 {
+    if (loop_branch(cpu->ins.slot) && (cpu->reg.PC < cpu->ins.address)) 
+        watch_idle_loop(cpu);
+
+#if TRACE_SUPPORT
+    if ((cpu->trace != NULL) && !cpu->ins.cb_prefixed) // The prefix already logged its operation.
+        trace_ins(cpu, TRACE_INSTRUCTION, cpu->reg.PC);
+#endif
+
+#if PROFILE_SUPPORT
+    if ((cpu->profiler != NULL) && !cpu->ins.cb_prefixed) // CB operations stay with their prefix.
+        profile_location(cpu, cpu->reg.PC);
+#endif
+
     reset_ins(cpu);
+    cpu->ins.decoded = lookup_decoded(cpu);
     cpu->ins. opcode = fetch(cpu);
+    if (cpu->ins.decoded != NULL)
+    {
+        cpu->    ins.handler = cpu->ins.decoded->handler;
+        cpu->       ins.slot = cpu->ins.decoded->cb_prefixed ? (PREFIX_SLOT + cpu->ins.opcode) : cpu->ins.opcode;
+        cpu->ins.cb_prefixed = false;
+        return;
+    }
     if (cpu->ins.cb_prefixed)
     {
-        cpu->      ins.label = cb_opcode_word[cpu->ins.opcode];
         cpu->    ins.handler = prefix_opcode_table[cpu->ins.opcode];
+        cpu->       ins.slot = PREFIX_SLOT + cpu->ins.opcode;
         cpu->ins.cb_prefixed = false;
         return;
     }
-    cpu->ins.  label = opcode_word[cpu->ins.opcode];
     cpu->ins.handler = opcode_table[cpu->ins.opcode];
+    cpu->ins.   slot = cpu->ins.opcode;
 }
 
+#if BLOCK_EXEC_SUPPORT || THREADED_DISPATCH
+
+/*
+    Moves on to the next instruction of a block's register-only head. Those
+    instructions never touch the bus, so the block and its bank still hold
+    and only the address needs checking. Branches that left the block, the
+    HALT bug and traced or profiled runs go through next_ins.
+*/
+static void next_block_ins(CPU *cpu, CodeBlock *block)
+{
+    const DecodedInstruction *entry = &block->ins[cpu->block_next];
+
+    if ((entry->address != cpu->reg.PC) || (entry->cb_prefixed != cpu->ins.cb_prefixed) || 
+        cpu->halt_bug_active || (cpu->trace != NULL) || (cpu->profiler != NULL))
+    {
+        next_ins(cpu);
+        return;
+    }
+
+    cpu->ins.    address = cpu->reg.PC++;
+    cpu->ins.   duration = 0;
+    cpu->ins.     length = 1;
+    cpu->ins.        low = 0;
+    cpu->ins.       high = 0;
+    cpu->ins.     opcode = entry->opcode;
+    cpu->ins.   executed = false;
+    cpu->ins.    handler = entry->handler;
+    cpu->ins.    decoded = entry;
+    cpu->ins.       slot = entry->cb_prefixed ? (PREFIX_SLOT + entry->opcode) : entry->opcode;
+    cpu->ins.cb_prefixed = false;
+
+    cpu->block_next++;
+}
+
+#endif
+
 static void check_ins(CPU *cpu)
 {
     if (cpu->ins.executed)
@@ -5020,31 +5724,425 @@ static void check_ins(CPU *cpu)
     }
 }
 
+static void retire_ins(CPU *cpu)
+{
+#if PROFILE_SUPPORT
+    if (cpu->profiler != NULL) profile_retire(cpu->profiler, cpu->profile_index, cpu->ins.slot);
+#endif
+
+    if (!cpu->ime_scheduled) return;
+
+    cpu->ime_delay--;
+
+    if (cpu->ime_delay == 0)
+    {
+        cpu->          ime =  true;
+        cpu->ime_scheduled = false;
+    }
+}
+
+// Instruction Execution Mode
+
+static inline bool bus_sensitive(uint16_t address) // VRAM, OAM, IO and IE follow the PPU and timers.
+{
+    return ((address >= VRAM_START) && (address <= VRAM_END))         ||
+           ((address >= OAM_START)  && (address <= IO_REGISTERS_END)) ||
+           (address == INTERRUPT_ENABLE);
+}
+
+static inline bool stack_sensitive(uint16_t sp)
+{
+    return bus_sensitive(sp - 2) || bus_sensitive(sp - 1) || bus_sensitive(sp) || bus_sensitive(sp + 1);
+}
+
+static bool needs_sync(CPU *cpu, const DecodedInstruction *entry)
+{
+    uint8_t   opcode = entry->opcode;
+    uint16_t operand = (entry->bytes[2] << BYTE) | entry->bytes[1];
+
+    if (entry->cb_prefixed)
+        return ((opcode & LOWER_3_MASK) == 0x06) && bus_sensitive(getDR(cpu, HL_REG));
+
+    switch(opcode)
+    {
+        case LD_BC_A:  case LD_A_BC:
+            return bus_sensitive(getDR(cpu, BC_REG));
+
+        case LD_DE_A:  case LD_A_DE:
+            return bus_sensitive(getDR(cpu, DE_REG));
+
+        case LD_HLI_A: case LD_A_HLI: case LD_HLD_A: case LD_A_HLD:
+        case INC_HL_MEM: case DEC_HL_MEM: case LD_HL_N:
+            return bus_sensitive(getDR(cpu, HL_REG));
+
+        case LD_NN_SP:
+            return bus_sensitive(operand) || bus_sensitive(operand + 1);
+
+        case LD_NN_A:  case LD_A_NN:
+            return bus_sensitive(operand);
+
+        case LDH_N_A:  case LDH_A_N:
+            return bus_sensitive(0xFF00 | entry->bytes[1]);
+
+        case LDH_C_A:  case LDH_A_C:
+            return bus_sensitive(0xFF00 | cpu->reg.C);
+
+        case PUSH_BC:  case PUSH_DE:  case PUSH_HL:  case PUSH_AF:
+        case POP_BC:   case POP_DE:   case POP_HL:   case POP_AF:
+        case CALL_NN:  case CALL_NZ_NN: case CALL_Z_NN: case CALL_NC_NN: case CALL_C_NN:
+        case RET:      case RET_NZ:   case RET_Z:    case RET_NC:   case RET_C:   case RETI:
+        case RST_00H:  case RST_08H:  case RST_10H:  case RST_18H:
+        case RST_20H:  case RST_28H:  case RST_30H:  case RST_38H:
+            return stack_sensitive(cpu->reg.SP);
+
+        case CB_PREFIX: case DI: case EI:
+            return false;
+
+        case HALT:     case STOP:
+            return true;
+    }
+
+    if (register_only((DecodedInstruction*) entry)) 
+        return false;
+
+    if ((opcode >= LD_B_B) && (opcode <= CP_A_A)) // Remaining (HL) operands.
+        return bus_sensitive(getDR(cpu, HL_REG));
+
+    return true; // Unused opcodes stay on the reference path.
+}
+
+static inline bool instruction_ready(CPU *cpu)
+{
+    return (cpu->exec_mode == INSTRUCTION_EXEC) && (cpu->ins.duration == 0) && 
+           (cpu->ins.decoded != NULL) && !needs_sync(cpu, cpu->ins.decoded);
+}
+
+/*
+    Sets up the instruction that follows a run of "cycles" machine cycles
+    and says whether it can run on as well. Within the quiet cycles the
+    timer hands over, nothing can raise an interrupt or change what an
+    unsynced instruction reads, so starting it now gives the same result
+    as starting it on its own machine cycle. The check is what that cycle
+    would do first. Trace, profile and idle loop bookkeeping is per cycle,
+    and DMA copies on demand against the clock, so those end the run.
+*/
+static bool continue_run(CPU *cpu, uint8_t cycles, uint16_t quiet)
+{
+    if ((cycles > quiet) || (cycles > MAX_RUN_CYCLES)) return false;
+
+    if ((cpu->spin.state != SPIN_OFF) || (cpu->trace != NULL) || (cpu->profiler != NULL) || 
+        cpu->mem->dma.active || cpu->mem->hdma.active)
+        return false;
+
+    check_ins(cpu);
+    return instruction_ready(cpu);
+}
+
+// Threaded Dispatch
+
+#if THREADED_DISPATCH
+
+typedef enum
+{
+    STEP_SCOPE,        // A single micro-step.
+    INSTRUCTION_SCOPE, // The current instruction, then any that follow within the quiet cycles.
+    BLOCK_SCOPE        // Instructions to the end of the block's register-only head.
+
+} DispatchScope;
+
+static bool continue_block(CPU *cpu, CodeBlock *block)
+{
+    if ((block == NULL) || (cpu->block_next >= block->register_count)) 
+        return false;
+
+    next_block_ins(cpu, block); // Left pending for the interpreter if it fell out of the block.
+    return (cpu->ins.decoded == &block->ins[cpu->block_next - 1]);
+}
+
+static inline bool continue_scope(CPU *cpu, DispatchScope scope, CodeBlock *block, uint8_t cycles, uint16_t quiet)
+{
+    switch(scope)
+    {
+        case INSTRUCTION_SCOPE: return continue_run(cpu, cycles, quiet);
+        case BLOCK_SCOPE:       return continue_block(cpu, block);
+        default:                return false;
+    }
+}
+
+#define OPCODE_ROW(X, h) \
+    X(h##0) X(h##1) X(h##2) X(h##3) X(h##4) X(h##5) X(h##6) X(h##7) \
+    X(h##8) X(h##9) X(h##A) X(h##B) X(h##C) X(h##D) X(h##E) X(h##F)
+
+#define OPCODE_SPACE(X) \
+    OPCODE_ROW(X, 0x0) OPCODE_ROW(X, 0x1) OPCODE_ROW(X, 0x2) OPCODE_ROW(X, 0x3) \
+    OPCODE_ROW(X, 0x4) OPCODE_ROW(X, 0x5) OPCODE_ROW(X, 0x6) OPCODE_ROW(X, 0x7) \
+    OPCODE_ROW(X, 0x8) OPCODE_ROW(X, 0x9) OPCODE_ROW(X, 0xA) OPCODE_ROW(X, 0xB) \
+    OPCODE_ROW(X, 0xC) OPCODE_ROW(X, 0xD) OPCODE_ROW(X, 0xE) OPCODE_ROW(X, 0xF)
+
+#define BASE_SLOT(n)   [n] = &&base_##n,
+#define PREFIXED_SLOT(n) [PREFIX_SLOT + n] = &&prefix_##n,
+
+/*
+    Each opcode gets its own copy of the step loop and its own indirect 
+    jump to the next instruction, so the host predictor sees one branch 
+    per guest opcode rather than one shared call site. Handlers are named
+    through the const tables and resolve to direct (inlinable) calls.
+
+    BLOCK_SCOPE follows those jumps through a block's register-only head
+    and INSTRUCTION_SCOPE through the cycles the timer reports as quiet.
+    Cycle execution hands every step back to the timer and only uses the
+    entry jump in place of the call through ins.handler.
+*/
+#define THREADED_STEP(handler)                                                      \
+    do                                                                              \
+    {                                                                               \
+        cpu->ins.duration += 1;                                                     \
+        cpu->ins.executed  = handler(cpu);                                          \
+        cycles++;                                                                   \
+                                                                                    \
+    } while (!cpu->ins.executed && (scope != STEP_SCOPE));                          \
+                                                                                    \
+    if (cpu->ins.executed) retire_ins(cpu);                                         \
+    if (!continue_scope(cpu, scope, block, cycles, quiet)) return cycles;            \
+    goto *dispatch[cpu->ins.slot];
+
+#define BASE_OP(n)   base_##n:   THREADED_STEP(opcode_table[n])
+#define PREFIX_OP(n) prefix_##n: THREADED_STEP(prefix_opcode_table[n])
+
+static uint8_t threaded_exec(CPU *cpu, DispatchScope scope, uint16_t quiet)
+{
+    static const void *const dispatch[INTERRUPT_SLOT + 1] =
+    {
+        OPCODE_SPACE(BASE_SLOT)
+        OPCODE_SPACE(PREFIXED_SLOT)
+        [INTERRUPT_SLOT] = &&interrupt
+    };
+
+    CodeBlock *block = cpu->block;
+    uint8_t   cycles = 0;
+
+    goto *dispatch[cpu->ins.slot];
+
+    OPCODE_SPACE(BASE_OP)
+    OPCODE_SPACE(PREFIX_OP)
+
+    interrupt: THREADED_STEP(int_exec)
+}
+
+#undef PREFIX_OP
+#undef BASE_OP
+#undef THREADED_STEP
+#undef PREFIXED_SLOT
+#undef BASE_SLOT
+#undef OPCODE_SPACE
+#undef OPCODE_ROW
+
+#else
+
 static void execute_ins(CPU *cpu)
 {
     cpu->ins.duration += 1; // Steps through micro-instructions
     cpu->ins.executed = cpu->ins.handler(cpu);
 
-    if (cpu->ime_scheduled && cpu->ins.executed)
+    if (cpu->ins.executed) retire_ins(cpu);
+}
+
+#endif
+
+static inline void step_ins(CPU *cpu)
+{
+#if THREADED_DISPATCH
+    threaded_exec(cpu, STEP_SCOPE, 0);
+#else
+    execute_ins(cpu);
+#endif
+}
+
+/*
+    Runs the current instruction to completion, then any that follow
+    within "quiet" machine cycles, and returns the cycle cost.
+*/
+static uint8_t run_ins(CPU *cpu, uint16_t quiet)
+{
+#if THREADED_DISPATCH
+    return threaded_exec(cpu, INSTRUCTION_SCOPE, quiet);
+#else
+    uint8_t cycles = 0;
+
+    do
     {
-        cpu->ime_delay--;
+        execute_ins(cpu);
+        cycles++;
 
-        if (cpu->ime_delay == 0)
-        {
-            cpu->          ime =  true;
-            cpu->ime_scheduled = false;
-        }
+    } while (!cpu->ins.executed || continue_run(cpu, cycles, quiet));
+
+    return cycles;
+#endif
+}
+
+// Block Execution
+
+#if BLOCK_EXEC_SUPPORT
+
+static inline bool block_ready(CPU *cpu)
+{
+    CodeBlock *block = cpu->block;
+
+    return cpu->block_exec && !cpu->ime_scheduled && (block != NULL) && (cpu->block_next == 1) &&
+           (block->register_count > 0) && (cpu->ins.decoded == &block->ins[0]);
+}
+
+/*
+    Runs the register-only head of a block to completion in one go. None 
+    of these instructions touch the bus, so the only thing the rest of the
+    system can notice is when they finish: the CPU idles for the machine 
+    cycles the block took while the timer and PPU catch up. Interrupts are
+    taken at the block exit instead of between instructions.
+
+    This is an interpreter over the decode cache, not a translator: the 
+    cached handlers are called back to back and no host code is emitted.
+    The gain comes from skipping the per-cycle stepping and from the timer
+    fast-forwarding the idle cycles left behind. That is about twice the 
+    speed of cycle execution on dispatch_bench, not the tenfold a 
+    translator was after: the clock driver, PPU and APU are most of the
+    cost that is left.
+*/
+static void execute_block(CPU *cpu)
+{
+#if THREADED_DISPATCH
+    uint8_t cycles = threaded_exec(cpu, BLOCK_SCOPE, 0);
+#else
+    CodeBlock *block = cpu->block;
+    uint8_t   cycles = 0;
+
+    while (true)
+    {
+        cycles += run_ins(cpu, 0);
+
+        if (cpu->block_next >= block->register_count) break;
+
+        next_block_ins(cpu, block); // Left pending for the interpreter if it fell out of the block.
+        if (cpu->ins.decoded != &block->ins[cpu->block_next - 1]) break;
     }
+#endif
+
+    cpu->idle_cycles = cycles - 1; // The first cycle is this one.
 }
 
-void machine_cycle(CPU *cpu)
+#endif
+
+// Execution Modes
+
+static void post_mode_request(CPU *cpu, uint8_t clear, uint8_t set)
+{
+    uint8_t request = atomic_load_explicit(&cpu->mode_request, memory_order_relaxed);
+    uint8_t  update;
+
+    do update = (request & ~clear) | set | MODE_REQUEST_PENDING;
+    while (!atomic_compare_exchange_weak_explicit(&cpu->mode_request, &request, update, 
+                                                  memory_order_release, memory_order_relaxed));
+}
+
+static void apply_mode_request(CPU *cpu) // Emulation thread only, between machine cycles.
+{
+    uint8_t request = atomic_fetch_and_explicit(&cpu->mode_request, (uint8_t) ~MODE_REQUEST_PENDING, 
+                                                memory_order_acquire);
+
+    stop_spin(cpu);
+    cpu->block_exec = BLOCK_EXEC_SUPPORT && (request & MODE_REQUEST_BLOCK);
+    cpu-> exec_mode = (request & MODE_REQUEST_INSTRUCTION) ? INSTRUCTION_EXEC : CYCLE_EXEC;
+
+#if TRACE_SUPPORT
+    cpu->trace = (request & MODE_REQUEST_TRACE) ? atomic_load_explicit(&cpu->trace_request, memory_order_relaxed) : NULL;
+#endif
+}
+
+void enable_block_exec(CPU *cpu, bool enabled)
+{
+    post_mode_request(cpu, MODE_REQUEST_BLOCK, enabled ? MODE_REQUEST_BLOCK : 0);
+}
+
+void set_exec_mode(CPU *cpu, ExecMode mode)
+{
+    post_mode_request(cpu, MODE_REQUEST_INSTRUCTION, (mode == INSTRUCTION_EXEC) ? MODE_REQUEST_INSTRUCTION : 0);
+}
+
+void attach_tracer(CPU *cpu, TraceBuffer *trace) // Detached once mode_requests_applied says so.
+{
+    atomic_store_explicit(&cpu->trace_request, trace, memory_order_relaxed); // Published by the request.
+    post_mode_request(cpu, MODE_REQUEST_TRACE, (trace != NULL) ? MODE_REQUEST_TRACE : 0);
+}
+
+bool block_exec_requested(CPU *cpu)
+{
+    return BLOCK_EXEC_SUPPORT && (atomic_load(&cpu->mode_request) & MODE_REQUEST_BLOCK);
+}
+
+ExecMode exec_mode_requested(CPU *cpu)
+{
+    return (atomic_load(&cpu->mode_request) & MODE_REQUEST_INSTRUCTION) ? INSTRUCTION_EXEC : CYCLE_EXEC;
+}
+
+bool mode_requests_applied(CPU *cpu)
+{
+    return !(atomic_load(&cpu->mode_request) & MODE_REQUEST_PENDING);
+}
+
+static void run_machine_cycle(CPU *cpu)
 {
     check_pending_interrupts(cpu); // Unhalts If Interrupt Pending
     
     if (!cpu->running || cpu->halted) return;
 
+    if (spin_cycle(cpu)) return; // Polling loop waiting on the PPU or timer.
+
+    if (cpu->idle_cycles > 0) // Peripherals catching up with code that already ran.
+    {
+        cpu->idle_cycles--;
+        return;
+    }
+
     check_ins(cpu);
-    execute_ins(cpu); // Continue Execution. 
+
+#if BLOCK_EXEC_SUPPORT
+    if (block_ready(cpu))
+    {
+        execute_block(cpu);
+        return;
+    }
+#endif
+
+    if (instruction_ready(cpu))
+    {
+        cpu->idle_cycles = run_ins(cpu, quiet_cycles(cpu->sched->timer)) - 1;
+        return;
+    }
+
+    step_ins(cpu); // Continue Execution. 
+}
+
+void machine_cycle(CPU *cpu)
+{
+    if (atomic_load_explicit(&cpu->mode_request, memory_order_relaxed) & MODE_REQUEST_PENDING)
+        apply_mode_request(cpu);
+
+    run_machine_cycle(cpu);
+
+#if PROFILE_SUPPORT
+    if (cpu->profiler != NULL) profile_machine_cycle(cpu);
+#endif
+}
+
+bool idle_cycle_ready(CPU *cpu) // The next machine cycle would only count down idle_cycles.
+{
+    if (!cpu->running || cpu->halted || (cpu->idle_cycles == 0) || (cpu->spin.state != SPIN_OFF)) 
+        return false;
+
+#if PROFILE_SUPPORT
+    if (cpu->profiler != NULL) return false;
+#endif
+
+    return !(atomic_load_explicit(&cpu->mode_request, memory_order_relaxed) & MODE_REQUEST_PENDING);
 }
 
 void reset_cpu(CPU *cpu)
@@ -5058,6 +6156,9 @@ void reset_cpu(CPU *cpu)
 
     cpu->reg.PC =       0x0100;
     cpu->reg.SP = HIGH_RAM_END;
+
+    cpu->flags.op = FLAGS_RESOLVED;
+    cpu->spin.state = SPIN_OFF;
 }
 
 void start_cpu(CPU *cpu)
@@ -5074,6 +6175,8 @@ void link_cpu(CPU *cpu, GbcEmu *emu)
 {
     cpu-> cart = emu->cart;
     cpu->  mem = emu->mem;
+    cpu->timer = emu->timer;
+    cpu->sched = emu->sched;
 
     cpu->reg.IER = &(emu->mem->memory[IER]);
     cpu->reg.IFR = &(emu->mem->memory[IFR]);
@@ -5088,11 +6191,27 @@ CPU *init_cpu()
 
     reset_cpu(cpu);
 
+    cpu->    blocks = (CodeBlock*) calloc(BLOCK_CACHE_SIZE, sizeof(CodeBlock));
+    cpu->     block = NULL;
+    cpu->block_next = 0;
+    cpu->ram_blocks = 0;
+
+    cpu->  exec_mode = CYCLE_EXEC;
+    cpu-> block_exec =      false;
+    cpu->idle_cycles =          0;
+    cpu->      trace =       NULL;
+    atomic_init(&cpu->mode_request, 0);
+    atomic_init(&cpu->trace_request, NULL);
+    cpu->   profiler =       NULL;
+
     return cpu;
 }
 
 void tidy_cpu(CPU **cpu)
 {
+    free((*cpu)->blocks);
+    (*cpu)->blocks = NULL;
+
     free(*cpu); 
     *cpu = NULL;
 }
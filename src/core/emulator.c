@@ -6,6 +6,7 @@
 #include "core/timer.h"
 #include "core/apu.h"
 #include "core/ppu.h"
+#include "core/scheduler.h"
 #include "core/emulator.h"
 
 static void dmg_bios(GbcEmu *emu)
@@ -62,6 +63,8 @@ static void link_emulator(GbcEmu *emu)
     link_cpu(emu->cpu, emu);
     link_apu(emu->apu, emu);
     link_ppu(emu->ppu, emu);
+    link_scheduler(emu->sched, emu);
+    link_cartridge(emu->cart, emu);
 }
 
 static void empty_cartridge(GbcEmu *emu)
@@ -101,6 +104,12 @@ static void empty_cartridge(GbcEmu *emu)
         tidy_ppu(&emu->ppu);
         emu->ppu = NULL;
     }
+
+    if (emu->sched != NULL)
+    {
+        tidy_scheduler(&emu->sched);
+        emu->sched = NULL;
+    }
 }
 
 void load_cartridge(GbcEmu *emu, const char *file_path, const char *file_name)
@@ -111,6 +120,7 @@ void load_cartridge(GbcEmu *emu, const char *file_path, const char *file_name)
     emu->timer = init_timer();
     emu->  apu = init_apu();
     emu->  ppu = init_ppu();
+    emu->sched = init_scheduler();
 
     link_emulator(emu);
     load_cartridge_save(emu->cart);
@@ -141,6 +151,7 @@ void tidy_emulator(GbcEmu **emu)
     tidy_timer(&temp->timer);
     tidy_apu(&temp->apu);
     tidy_ppu(&temp->ppu);
+    tidy_scheduler(&temp->sched);
 
     free(*emu); 
     *emu = NULL;
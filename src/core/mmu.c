@@ -9,16 +9,128 @@
 #include "core/apu.h"
 #include "core/ppu.h"
 #include "core/mmu.h"
+#include "core/scheduler.h"
 
 #include "util/common.h"
 
 typedef uint8_t (*MemoryReadHandler)(EmuMemory*, uint16_t);
 typedef void (*MemoryWriteHandler)(EmuMemory*, uint16_t, uint8_t);
 
-MemoryReadHandler   memory_read_table[MEMORY_SIZE];
-MemoryWriteHandler memory_write_table[MEMORY_SIZE];
+/*
+    Pages with a direct pointer never reach these tables. The page 
+    handlers cover whole regions, the I/O handlers split $FF00 - $FFFF 
+    by register.
+*/
+static MemoryReadHandler   page_read_table[PAGE_COUNT];
+static MemoryWriteHandler page_write_table[PAGE_COUNT];
+
+static MemoryReadHandler    io_read_table[PAGE_SIZE];
+static MemoryWriteHandler  io_write_table[PAGE_SIZE];
+
+static uint8_t io_mask_table[PAGE_SIZE] = {0};
+
+#define IO(address) ((address) & PAGE_MASK)
+
+
+// PAGE MAPPING
+
+
+static void map_pages(uint8_t **table, uint16_t start, uint16_t end, uint8_t *base)
+{
+    for (uint16_t page = (start >> PAGE_SHIFT); page <= (end >> PAGE_SHIFT); page++)
+    {
+        table[page] = base;
+        if (base != NULL) base += PAGE_SIZE;
+    }
+}
+
+/*
+    External RAM is read in place but written through the cartridge, 
+    which tracks the pages a battery save has to pick up.
+*/
+static void remap_cart(EmuMemory *mem)
+{
+    Cartridge *cart = mem->cart;
+
+    map_pages(mem-> read_page, ROM_STATIC_START,  ROM_STATIC_END,  cart->rom0_base);
+    map_pages(mem-> read_page, ROM_DYNAMIC_START, ROM_DYNAMIC_END, cart->romx_base);
+    map_pages(mem-> read_page, EXT_RAM_START,     EXT_RAM_END,     cart->ram_base);
+}
+
+void remap_vram(EmuMemory *mem)
+{
+    uint8_t *bank = mem->vram[mem->memory[VBK] & BIT_0_MASK];
+
+    map_pages(mem-> read_page, VRAM_START, VRAM_END, mem->vram_read_blocked  ? NULL : bank);
+    map_pages(mem->write_page, VRAM_START, VRAM_END, mem->vram_write_blocked ? NULL : bank);
+    map_pages(mem->write_page, VRAM_START, B2_ADDRESS_END, NULL); // Tile data stores invalidate decoded tiles.
+}
+
+/*
+    Echo RAM shares the WRAM pointers. Its last page stops at $FDFF, so 
+    it maps one page short of the $D000 - $DFFF bank it mirrors.
+*/
+static void remap_wram(EmuMemory *mem)
+{
+    uint8_t svbk = mem->memory[SVBK] & LOWER_3_MASK;
+    if (svbk == 0) svbk = 1;
+
+    uint8_t **tables[2] = { mem->read_page, mem->write_page };
+
+    for (int i = 0; i < 2; i++)
+    {
+        map_pages(tables[i], WRAM_STATIC_START,  WRAM_STATIC_END,  mem->wram[0]);
+        map_pages(tables[i], WRAM_DYNAMIC_START, WRAM_DYNAMIC_END, mem->wram[svbk]);
+        map_pages(tables[i], ECHO_RAM_START,     0xEFFF,           mem->wram[0]);
+        map_pages(tables[i], 0xF000,             ECHO_RAM_END,     mem->wram[svbk]);
+    }
+
+    for (uint16_t page = (WRAM_STATIC_START >> PAGE_SHIFT); page <= (ECHO_RAM_END >> PAGE_SHIFT); page++)
+        if (mem->guard[page] != 0) mem->write_page[page] = NULL;
+}
+
+/*
+    Guarded WRAM pages lose their direct write pointer, and so does their
+    echo, so stores fall back to the handlers that check the code map and
+    settle a bulk OAM DMA.
+*/
+static void guard_page(EmuMemory *mem, uint16_t address, PageGuard guard)
+{
+    uint16_t page  = address >> PAGE_SHIFT;
+    uint16_t shift = ECHO_RAM_OFFSET >> PAGE_SHIFT;
+    uint16_t alias = (address < ECHO_RAM_START) ? (page + shift) : (page - shift);
 
-static uint8_t memory_mask_table[MEMORY_SIZE] = {0};
+    mem->guard[page]     |= guard;
+    mem->write_page[page] = NULL;
+
+    if (alias <= (ECHO_RAM_END >> PAGE_SHIFT))
+    {
+        mem->guard[alias]     |= guard;
+        mem->write_page[alias] = NULL;
+    }
+}
+
+static void release_guard(EmuMemory *mem, PageGuard guard)
+{
+    for (uint16_t page = 0; page < PAGE_COUNT; page++)
+        mem->guard[page] &= ~guard;
+
+    remap_wram(mem);
+}
+
+void mark_ram_code(EmuMemory *mem, uint16_t address)
+{
+    mem->code_map[address - WRAM_STATIC_START] = true;
+
+    if (address <= WRAM_DYNAMIC_END) // High RAM is always handled.
+        guard_page(mem, address, CODE_GUARD);
+}
+
+void clear_ram_code(EmuMemory *mem)
+{
+    memset(mem->code_map, 0, CODE_MAP_SIZE);
+    release_guard(mem, CODE_GUARD);
+}
 
 
 // I/O API
@@ -40,46 +152,238 @@ uint8_t read_cram(EmuMemory *mem, bool is_obj, uint8_t palette_index, uint8_t co
     return mem->cram[base + offset + index];
 }
 
-uint8_t read_memory(EmuMemory *mem, uint16_t address)
+uint8_t read_unmapped(EmuMemory *mem, uint16_t address)
 {
-    return (memory_read_table[address](mem, address) | memory_mask_table[address]);
+    return page_read_table[address >> PAGE_SHIFT](mem, address);
 }
 
-void write_memory(EmuMemory *mem, uint16_t address, uint8_t value)
+void write_unmapped(EmuMemory *mem, uint16_t address, uint8_t value)
 { 
-    memory_write_table[address](mem, address, value); 
+    page_write_table[address >> PAGE_SHIFT](mem, address, value); 
+}
+
+/*
+    HDMA chunks whose source is plain cartridge or work RAM are copied in 
+    runs. The CPU is stalled for the whole chunk, so the only thing that 
+    can tell is the PPU locking or unlocking VRAM, which drops or admits
+    the writes, and an OAM DMA reading VRAM. Both settle the chunk first.
+*/
+static uint16_t hdma_chunk(EmuMemory *mem)
+{
+    uint16_t bytes = (mem->hdma.mode == HBLANK_HDMA) ? 16 : mem->hdma.length;
+    uint16_t  room = (VRAM_END + 1) - mem->hdma.dst;
+
+    if (bytes > mem->hdma.length) bytes = mem->hdma.length;
+    if (bytes > room) bytes = room;
+
+    return bytes;
+}
+
+static bool bulk_hdma_source(uint16_t src, uint16_t bytes)
+{
+    uint32_t end = (uint32_t) src + bytes - 1;
+
+    bool rom = (end <= ROM_DYNAMIC_END);
+    bool ram = (src >= EXT_RAM_START) && (end <= WRAM_DYNAMIC_END);
+
+    return rom || ram;
+}
+
+static void copy_hdma_run(EmuMemory *mem, uint16_t count)
+{
+    uint8_t  bank = mem->memory[VBK] & BIT_0_MASK;
+    uint8_t *vram = mem->vram[bank] - VRAM_START;
+
+    while (count > 0)
+    {
+        uint16_t  src = mem->hdma.src;
+        uint8_t *page = mem->read_page[src >> PAGE_SHIFT];
+        uint16_t  run = PAGE_SIZE - (src & PAGE_MASK);
+
+        if (run > count) run = count;
+
+        if (!mem->vram_write_blocked)
+        {
+            if (page != NULL)
+                memcpy(&vram[mem->hdma.dst], &page[src & PAGE_MASK], run);
+            else
+                for (uint16_t i = 0; i < run; i++)
+                    vram[mem->hdma.dst + i] = read_memory(mem, src + i);
+
+            invalidate_tiles(mem->ppu, bank, mem->hdma.dst, run);
+        }
+
+        mem->hdma.src               += run;
+        mem->hdma.dst               += run;
+        mem->hdma.length            -= run;
+        mem->hdma.bytes_transferred += run;
+        count                       -= run;
+    }
+}
+
+static void sync_hdma(EmuMemory *mem, uint64_t cycle)
+{
+    if (!mem->hdma.bulk || (cycle <= mem->hdma.start))
+        return;
+
+    uint64_t due = (cycle - mem->hdma.start) / HDMA_BYTE_DOTS;
+
+    if (due > mem->hdma.chunk) due = mem->hdma.chunk;
+    if (due <= mem->hdma.bytes_transferred) return;
+
+    copy_hdma_run(mem, (uint16_t) (due - mem->hdma.bytes_transferred));
+}
+
+void sync_vram_dma(EmuMemory *mem)
+{
+    sync_hdma(mem, mem->sched->cycle - 1); // The PPU runs ahead of this dot's events.
+}
+
+/*
+    A bulk DMA keeps the per-byte timeline but only copies when something
+    could tell the difference: the PPU's OAM scan, CPU access to OAM, a 
+    store to the source page, or a bank switch over it. Bytes are due on 
+    the dots their per-byte events would have fired on.
+*/
+static void sync_dma(EmuMemory *mem, uint64_t cycle)
+{
+    if (!mem->dma.bulk || (cycle < mem->dma.start))
+        return;
+
+    uint32_t  due = ((cycle - mem->dma.start) / mem->dma.period) + 1;
+    uint32_t done = OAM_SIZE - mem->dma.length;
+
+    if (due > OAM_SIZE) due = OAM_SIZE;
+    if (due <= done) return;
+
+    uint32_t count = due - done;
+    uint8_t  *page = mem->read_page[mem->dma.src >> PAGE_SHIFT];
+
+    memcpy(&mem->oam[mem->dma.dst - OAM_START], &page[mem->dma.src & PAGE_MASK], count);
+    invalidate_oam(mem->ppu);
+
+    mem->   dma.src += count;
+    mem->   dma.dst += count;
+    mem->dma.length -= count;
+}
+
+void sync_oam_dma(EmuMemory *mem)
+{
+    sync_dma(mem, mem->sched->cycle - 1); // The PPU runs ahead of this dot's events.
+}
+
+static bool bulk_dma_source(EmuMemory *mem)
+{
+    uint16_t src = mem->dma.src;
+
+    bool  rom = (src <= ROM_DYNAMIC_END);
+    bool wram = (src >= WRAM_STATIC_START) && (src <= ECHO_RAM_END);
+
+    return (rom || wram) && (mem->read_page[src >> PAGE_SHIFT] != NULL);
+}
+
+static void start_bulk_dma(EmuMemory *mem)
+{
+    mem->  dma.bulk = true;
+    mem-> dma.start = mem->sched->cycle;
+    mem->dma.period = mem->timer->dot; // Just reloaded on a machine cycle.
+
+    if (mem->dma.src >= WRAM_STATIC_START)
+        guard_page(mem, mem->dma.src, DMA_GUARD);
+
+    schedule_event(mem->sched, DMA_EVENT, (uint64_t) (OAM_SIZE - 1) * mem->dma.period);
+    sync_dma(mem, mem->sched->cycle);
+}
+
+static void stop_bulk_dma(EmuMemory *mem)
+{
+    if (!mem->dma.bulk) return;
+
+    sync_dma(mem, mem->sched->cycle);
+
+    mem->dma.bulk = false;
+    release_guard(mem, DMA_GUARD);
+}
+
+/*
+    Returns a bulk DMA to per-byte events, picking up on the dot the next
+    byte was due. Used when a speed switch would change the byte period.
+*/
+static void split_bulk_dma(EmuMemory *mem)
+{
+    if (!mem->dma.bulk || !mem->dma.active) return;
+
+    stop_bulk_dma(mem);
+
+    uint64_t next = mem->dma.start + ((uint64_t) (OAM_SIZE - mem->dma.length) * mem->dma.period);
+    schedule_event(mem->sched, DMA_EVENT, next - mem->sched->cycle);
+}
+
+static void finish_dma(EmuMemory *mem)
+{
+    stop_bulk_dma(mem);
+
+    mem-> oam_read_blocked = false;
+    mem->oam_write_blocked = false;
+    mem->       dma.active = false;
+    cancel_event(mem->sched, DMA_EVENT);
 }
 
-void check_dma_transfer(EmuMemory *mem)
+void dma_event(EmuMemory *mem)
 {
     if (!mem->dma.active)
         return;
 
+    if (mem->dma.bulk)
+    {
+        finish_dma(mem);
+        return;
+    }
+
+    schedule_machine_event(mem->sched, DMA_EVENT);
+
     if (mem->dma.length == (DMA_DURATION - 1))
     {
         mem-> oam_read_blocked = true;
         mem->oam_write_blocked = true;
     }
 
-    if (mem->dma.length > 160)
+    if (mem->dma.length > OAM_SIZE)
     {
         mem->dma.length--;
         return;
     }
 
+    if ((mem->dma.length == OAM_SIZE) && bulk_dma_source(mem))
+    {
+        start_bulk_dma(mem);
+        return;
+    }
+
+    sync_hdma(mem, mem->sched->cycle); // The source may be VRAM.
+
     uint8_t byte = read_memory(mem, mem->dma.src);
     mem->dma.src++;
     mem->oam[mem->dma.dst - OAM_START] = byte;
+    invalidate_oam(mem->ppu);
     mem->dma.dst++; 
 
     mem->dma.length--;
 
     if (mem->dma.length == 0)
-    {
-        mem-> oam_read_blocked = false;
-        mem->oam_write_blocked = false;
-        mem->       dma.active = false;
-    }
+        finish_dma(mem);
+}
+
+static void start_hdma_chunk(EmuMemory *mem)
+{
+    mem->hdma.bytes_transferring = true;
+    mem->hdma.bytes_transferred  =    0;
+    mem->hdma.chunk              = hdma_chunk(mem);
+    mem->hdma.bulk               = bulk_hdma_source(mem->hdma.src, mem->hdma.chunk);
+    mem->hdma.start              = mem->sched->cycle;
+
+    uint64_t delay = mem->hdma.bulk ? ((uint64_t) mem->hdma.chunk * HDMA_BYTE_DOTS) : HDMA_BYTE_DOTS;
+    schedule_event(mem->sched, HDMA_EVENT, delay);
 }
 
 void check_hdma_trigger(EmuMemory *mem)
@@ -87,23 +391,26 @@ void check_hdma_trigger(EmuMemory *mem)
     if (!mem->hdma.active || (mem->hdma.mode != HBLANK_HDMA) || !mem->cart->is_gbc)
         return;
     
-    mem->hdma.bytes_transferring = true;
-    mem->hdma.bytes_transferred  =    0;
+    start_hdma_chunk(mem);
 }
 
-void check_hdma_transfer(EmuMemory *mem)
+void hdma_event(EmuMemory *mem)
 {
     if (!mem->hdma.active || !mem->hdma.bytes_transferring)
         return;
 
-    mem->hdma.counter++;
-    if (mem->hdma.counter < 2) return;
-    mem->hdma.counter = 0;
-
-    uint8_t byte = read_memory(mem, mem->hdma.src++);
-    write_memory(mem, mem->hdma.dst++, byte);
-    mem->hdma.bytes_transferred++;
-    mem->hdma.length--;
+    if (mem->hdma.bulk)
+    {
+        sync_hdma(mem, mem->sched->cycle); // The whole chunk is due.
+        mem->hdma.bulk = false;
+    }
+    else
+    {
+        uint8_t byte = read_memory(mem, mem->hdma.src++);
+        write_memory(mem, mem->hdma.dst++, byte);
+        mem->hdma.bytes_transferred++;
+        mem->hdma.length--;
+    }
 
     if ((mem->hdma.length == 0) || (mem->hdma.dst > VRAM_END))
     {
@@ -121,6 +428,9 @@ void check_hdma_transfer(EmuMemory *mem)
 
     mem->memory[HDMA5] &= BIT_7_MASK;
     mem->memory[HDMA5] |= ((mem->hdma.length / 0x10) - 1) & LOWER_7_MASK;
+
+    if (mem->hdma.bytes_transferring)
+        schedule_event(mem->sched, HDMA_EVENT, HDMA_BYTE_DOTS);
 }
 
 // HIGH-LEVEL MEMORY
@@ -136,6 +446,12 @@ static void default_write(EmuMemory *mem, uint16_t address, uint8_t value)
     mem->memory[address] = value;
 }
 
+static inline void check_code_write(EmuMemory *mem, uint16_t address)
+{
+    if (mem->code_map[address - WRAM_STATIC_START])
+        flush_ram_code(mem->cpu);
+}
+
 // [$0000 - $7FFF] ROM, [$A000 - $BFFF] Cartridge RAM
 
 static uint8_t read_cart_memory(EmuMemory *mem, uint16_t address)
@@ -148,6 +464,13 @@ static void write_cart_memory(EmuMemory *mem, uint16_t address, uint8_t value)
     write_cartridge(mem->cart, address, value);
 }
 
+static void write_cart_register(EmuMemory *mem, uint16_t address, uint8_t value)
+{
+    sync_dma(mem, mem->sched->cycle);
+    write_cartridge(mem->cart, address, value);
+    remap_cart(mem); // Bank and mode registers.
+}
+
 // [$8000 - $9FFF] VRAM
 
 static uint8_t read_vram(EmuMemory *mem, uint16_t address)
@@ -163,9 +486,9 @@ static void write_vram(EmuMemory *mem, uint16_t address, uint8_t value)
 {   
     if (mem->vram_write_blocked) return;
 
-    address -= VRAM_START;
     uint8_t bank = mem->memory[VBK] & BIT_0_MASK;
-    mem->vram[bank][address] = value;
+    mem->vram[bank][address - VRAM_START] = value;
+    invalidate_tiles(mem->ppu, bank, address, 1);
 }
 
 // [$C000 - $CFFF] Static WRAM
@@ -178,6 +501,8 @@ static uint8_t read_static_wram(EmuMemory *mem, uint16_t address)
 
 static void write_static_wram(EmuMemory *mem, uint16_t address, uint8_t value)
 {
+    sync_dma(mem, mem->sched->cycle);
+    check_code_write(mem, address);
     address -= WRAM_STATIC_START;
     mem->wram[0][address] = value;
 }
@@ -194,6 +519,8 @@ static uint8_t read_dynamic_wram(EmuMemory *mem, uint16_t address)
 
 static void write_dynamic_wram(EmuMemory *mem, uint16_t address, uint8_t value)
 {
+    sync_dma(mem, mem->sched->cycle);
+    check_code_write(mem, address);
     address -= WRAM_DYNAMIC_START;
     uint8_t svbk = mem->memory[SVBK] & LOWER_3_MASK;
     if (svbk == 0) svbk = 1;
@@ -212,10 +539,20 @@ static void write_echo_ram(EmuMemory *mem, uint16_t address, uint8_t value)
     write_memory(mem, (address - 0x2000), value);
 }
 
+// [$FF80 - $FFFE] High RAM
+
+static void write_high_ram(EmuMemory *mem, uint16_t address, uint8_t value)
+{
+    check_code_write(mem, address);
+    mem->memory[address] = value;
+}
+
 // [$FE00 - $FE9F] OAM
 
 static uint8_t read_oam(EmuMemory *mem, uint16_t address)
 {
+    sync_dma(mem, mem->sched->cycle);
+
     if (mem->oam_read_blocked) return OPEN_BUS;
 
     address -= OAM_START;
@@ -225,11 +562,46 @@ static uint8_t read_oam(EmuMemory *mem, uint16_t address)
 
 static void write_oam(EmuMemory *mem, uint16_t address, uint8_t value)
 {
+    sync_dma(mem, mem->sched->cycle);
+
     if (mem->oam_write_blocked) return;
 
     address -= OAM_START;
 
     mem->oam[address] = value;
+    invalidate_oam(mem->ppu);
+}
+
+// [$FE00 - $FEFF] OAM and Unusable
+
+static uint8_t read_oam_page(EmuMemory *mem, uint16_t address)
+{
+    if (address < NOT_USABLE_START) return read_oam(mem, address);
+
+    return default_read(mem, address);
+}
+
+static void write_oam_page(EmuMemory *mem, uint16_t address, uint8_t value)
+{
+    if (address < NOT_USABLE_START) 
+    {
+        write_oam(mem, address, value);
+        return;
+    }
+
+    default_write(mem, address, value);
+}
+
+// [$FF00 - $FFFF] I/O, High RAM and IE
+
+static uint8_t read_io_page(EmuMemory *mem, uint16_t address)
+{
+    return (io_read_table[IO(address)](mem, address) | io_mask_table[IO(address)]);
+}
+
+static void write_io_page(EmuMemory *mem, uint16_t address, uint8_t value)
+{
+    io_write_table[IO(address)](mem, address, value);
 }
 
 
@@ -247,6 +619,26 @@ static void write_bios(EmuMemory *mem, uint16_t address, uint8_t value)
     mem->cart->bios_locked = true;
 }
 
+static void write_svbk(EmuMemory *mem, uint16_t address, uint8_t value)
+{
+    sync_dma(mem, mem->sched->cycle);
+    mem->memory[SVBK] = value;
+    flush_ram_code(mem->cpu); // Cached $D000 - $DFFF code belongs to the old bank.
+    remap_wram(mem);
+}
+
+static void write_key1(EmuMemory *mem, uint16_t address, uint8_t value)
+{
+    split_bulk_dma(mem); // STOP writes KEY1 once the speed has switched.
+    mem->memory[KEY1] = value;
+}
+
+static void write_vbk(EmuMemory *mem, uint16_t address, uint8_t value)
+{
+    mem->memory[VBK] = value;
+    remap_vram(mem);
+}
+
 // PPU
 
 static void write_ppu(EmuMemory *mem, uint16_t address, uint8_t value)
@@ -254,6 +646,19 @@ static void write_ppu(EmuMemory *mem, uint16_t address, uint8_t value)
     write_ppu_register(mem->ppu, address, value);
 }
 
+static void write_ppu_state(EmuMemory *mem, uint16_t address, uint8_t value) // Sampled mid-line by the renderer.
+{
+    sync_scanline(mem->ppu);
+    mem->memory[address] = value;
+}
+
+static void write_dmg_palette(EmuMemory *mem, uint16_t address, uint8_t value)
+{
+    sync_scanline(mem->ppu);
+    mem->memory[address] = value;
+    refresh_dmg_palette(mem->ppu, address);
+}
+
 static uint8_t read_bcpd(EmuMemory *mem, uint16_t address)
 {
     return mem->cram[(mem->memory[BCPS] & LOWER_6_MASK)];
@@ -261,8 +666,11 @@ static uint8_t read_bcpd(EmuMemory *mem, uint16_t address)
 
 static void write_bcpd(EmuMemory *mem, uint16_t address, uint8_t value)
 {
+    sync_scanline(mem->ppu);
+
     uint8_t index = mem->memory[BCPS] & LOWER_6_MASK;
     mem->cram[index] = value;
+    refresh_cram_color(mem->ppu, false, index);
     uint8_t inc_index = (index + 1) & LOWER_6_MASK;
     
     if(mem->memory[BCPS] & BIT_7_MASK)
@@ -278,8 +686,11 @@ static uint8_t read_ocpd(EmuMemory *mem, uint16_t address)
 
 static void write_ocpd(EmuMemory *mem, uint16_t address, uint8_t value)
 {
+    sync_scanline(mem->ppu);
+
     uint8_t index = mem->memory[OCPS] & LOWER_6_MASK;
     mem->cram[index + 0x40] = value;
+    refresh_cram_color(mem->ppu, true, index);
     uint8_t inc_index = (index + 1) & LOWER_6_MASK;
 
     if (mem->memory[OCPS] & BIT_7_MASK)
@@ -325,6 +736,8 @@ static void write_wave_ram(EmuMemory *mem, uint16_t address, uint8_t value)
 
 static void dma_handler(EmuMemory *mem, uint16_t address, uint8_t value)
 {
+    stop_bulk_dma(mem); // Settle the transfer being restarted.
+
     value = (value == 0xFF) ? 0xDF : value;
     value = (value == 0xFE) ? 0xE0 : value;
     uint16_t source = value * 0x0100;
@@ -336,6 +749,8 @@ static void dma_handler(EmuMemory *mem, uint16_t address, uint8_t value)
     mem->oam_read_blocked  = mem->dma.active;
     mem->oam_write_blocked = mem->dma.active;
     mem->dma.active        = true;
+
+    schedule_machine_event(mem->sched, DMA_EVENT);
 }
 
 
@@ -370,12 +785,15 @@ static void hdma_handler(EmuMemory *mem, uint16_t address, uint8_t value)
     mem->hdma.src                = src; 
     mem->hdma.dst                = dst;
     mem->hdma.length             = ((value & LOWER_7_MASK) + 1) * 0x10; // or << 4
-    mem->hdma.bytes_transferring = (mode == GENERAL_HDMA);
+    mem->hdma.bytes_transferring = false;
     mem->hdma.mode               = mode;
-    mem->hdma.counter            = 0;
     mem->hdma.bytes_transferred  = 0;
+    mem->hdma.bulk               = false;
 
     mem->memory[HDMA5] = value;
+
+    if (mode == GENERAL_HDMA)
+        start_hdma_chunk(mem);
 }
 
 // Emulation
@@ -422,178 +840,162 @@ void link_mmu(EmuMemory *mem, GbcEmu *emu)
     mem-> timer = emu->timer;
     mem->   apu = emu->apu;
     mem->   ppu = emu->ppu;
+    mem-> sched = emu->sched;
+
+    remap_cart(mem);
 }
 
-static void init_tables()
+static void map_handlers(uint16_t start, uint16_t end, MemoryReadHandler reader, MemoryWriteHandler writer)
 {
-    for (int index = ROM_STATIC_START; index < VRAM_START; index++)
+    for (uint16_t page = (start >> PAGE_SHIFT); page <= (end >> PAGE_SHIFT); page++)
     {
-        memory_read_table[index]  = read_cart_memory;
-        memory_write_table[index] = write_cart_memory;
-    }
-
-    for (int index = VRAM_START; index < EXT_RAM_START; index++)
-    {
-        memory_read_table[index]  = read_vram;
-        memory_write_table[index] = write_vram;
-    }
-
-    for (int index = EXT_RAM_START; index < WRAM_STATIC_START; index++)
-    {
-        memory_read_table[index]  =  read_cart_memory;
-        memory_write_table[index] = write_cart_memory;
-    }
-
-    for (int index = WRAM_STATIC_START; index < WRAM_DYNAMIC_START; index++)
-    {
-        memory_read_table[index]  = read_static_wram;
-        memory_write_table[index] = write_static_wram;
-    }
-
-    for (int index = WRAM_DYNAMIC_START; index < ECHO_RAM_START; index++)
-    {
-        memory_read_table[index]  = read_dynamic_wram;
-        memory_write_table[index] = write_dynamic_wram;
-    }
-    
-    for (int index = ECHO_RAM_START; index < OAM_START; index++)
-    {
-        memory_read_table[index]  = read_echo_ram;
-        memory_write_table[index] = write_echo_ram;
-    }
-
-    for (int index = OAM_START; index < NOT_USABLE_START; index++)
-    {
-        memory_read_table[index]  =  read_oam;
-        memory_write_table[index] = write_oam;
-    }
-
-    for (int index = NOT_USABLE_START; index < IO_REGISTERS_START; index++)
-    {
-        memory_read_table[index]  =  default_read;
-        memory_write_table[index] = default_write;
+        page_read_table[page]  = reader;
+        page_write_table[page] = writer;
     }
+}
 
-    for (int index = IO_REGISTERS_START; index < HIGH_RAM_START; index++)
+static void init_tables()
+{
+    map_handlers(ROM_STATIC_START,   ROM_DYNAMIC_END,  read_cart_memory,   write_cart_register);
+    map_handlers(VRAM_START,         VRAM_END,         read_vram,          write_vram);
+    map_handlers(EXT_RAM_START,      EXT_RAM_END,      read_cart_memory,   write_cart_memory);
+    map_handlers(WRAM_STATIC_START,  WRAM_STATIC_END,  read_static_wram,   write_static_wram);
+    map_handlers(WRAM_DYNAMIC_START, WRAM_DYNAMIC_END, read_dynamic_wram,  write_dynamic_wram);
+    map_handlers(ECHO_RAM_START,     ECHO_RAM_END,     read_echo_ram,      write_echo_ram);
+    map_handlers(OAM_START,          NOT_USABLE_END,   read_oam_page,      write_oam_page);
+    map_handlers(IO_REGISTERS_START, INTERRUPT_ENABLE, read_io_page,       write_io_page);
+
+    for (int index = 0; index < PAGE_SIZE; index++)
     {
-        memory_read_table[index]  =  default_read;
-        memory_write_table[index] = default_write;
+        io_read_table[index]  =  default_read;
+        io_write_table[index] = default_write;
     }
 
-    for (int index = HIGH_RAM_START; index <= INTERRUPT_ENABLE; index++)
-    {
-        memory_read_table[index]  =  default_read;
-        memory_write_table[index] = default_write;
-    }
+    for (int index = HIGH_RAM_START; index <= HIGH_RAM_END; index++)
+        io_write_table[IO(index)] = write_high_ram;
 
     // IO Registers (Overrides defaults set earlier)
 
     // PPU
-    memory_write_table[LCDC]  = write_ppu;
-    memory_write_table[STAT]  = write_ppu;
-    memory_write_table[LY]    = write_ppu;
-    memory_write_table[LYC]   = write_ppu;
+    io_write_table[IO(LCDC)]  = write_ppu;
+    io_write_table[IO(STAT)]  = write_ppu;
+    io_write_table[IO(LY)]    = write_ppu;
+    io_write_table[IO(LYC)]   = write_ppu;
+    io_write_table[IO(SCY)]   = write_ppu_state;
+    io_write_table[IO(SCX)]   = write_ppu_state;
+    io_write_table[IO(WY)]    = write_ppu_state;
+    io_write_table[IO(WX)]    = write_ppu_state;
+    io_write_table[IO(BGP)]   = write_dmg_palette;
+    io_write_table[IO(OBP0)]  = write_dmg_palette;
+    io_write_table[IO(OBP1)]  = write_dmg_palette;
 
     // Timer
-    memory_write_table[DIV]   = write_timer;
-    memory_write_table[TIMA]  = write_timer;
-    memory_write_table[TMA]   = write_timer; 
-    memory_write_table[TAC]   = write_timer;
+    io_write_table[IO(DIV)]   = write_timer;
+    io_write_table[IO(TIMA)]  = write_timer;
+    io_write_table[IO(TMA)]   = write_timer; 
+    io_write_table[IO(TAC)]   = write_timer;
 
     // CPU
-    memory_write_table[IFR]   = write_interrupt_flag;
+    io_write_table[IO(IFR)]   = write_interrupt_flag;
 
     // Channel 1
-    memory_write_table[NR10]  = write_audio;
-    memory_write_table[NR11]  = write_audio;
-    memory_write_table[NR12]  = write_audio;
-    memory_write_table[NR13]  = write_audio;
-    memory_write_table[NR14]  = write_audio;
+    io_write_table[IO(NR10)]  = write_audio;
+    io_write_table[IO(NR11)]  = write_audio;
+    io_write_table[IO(NR12)]  = write_audio;
+    io_write_table[IO(NR13)]  = write_audio;
+    io_write_table[IO(NR14)]  = write_audio;
     // Channel 2
-    memory_write_table[NR20]  = write_audio;
-    memory_write_table[NR21]  = write_audio;
-    memory_write_table[NR22]  = write_audio;
-    memory_write_table[NR23]  = write_audio;
-    memory_write_table[NR24]  = write_audio;
+    io_write_table[IO(NR20)]  = write_audio;
+    io_write_table[IO(NR21)]  = write_audio;
+    io_write_table[IO(NR22)]  = write_audio;
+    io_write_table[IO(NR23)]  = write_audio;
+    io_write_table[IO(NR24)]  = write_audio;
     // Channel 3
-    memory_write_table[NR30]  = write_audio;
-    memory_write_table[NR31]  = write_audio;
-    memory_write_table[NR32]  = write_audio;
-    memory_write_table[NR33]  = write_audio;
-    memory_write_table[NR34]  = write_audio;
+    io_write_table[IO(NR30)]  = write_audio;
+    io_write_table[IO(NR31)]  = write_audio;
+    io_write_table[IO(NR32)]  = write_audio;
+    io_write_table[IO(NR33)]  = write_audio;
+    io_write_table[IO(NR34)]  = write_audio;
     // Channel 4
-    memory_write_table[NR40]  = write_audio;
-    memory_write_table[NR41]  = write_audio;
-    memory_write_table[NR42]  = write_audio;
-    memory_write_table[NR43]  = write_audio;
-    memory_write_table[NR44]  = write_audio;
+    io_write_table[IO(NR40)]  = write_audio;
+    io_write_table[IO(NR41)]  = write_audio;
+    io_write_table[IO(NR42)]  = write_audio;
+    io_write_table[IO(NR43)]  = write_audio;
+    io_write_table[IO(NR44)]  = write_audio;
     // Global audio
-    memory_write_table[NR50]  = write_audio;
-    memory_write_table[NR51]  = write_audio;
-    memory_write_table[NR52]  = write_audio;
+    io_write_table[IO(NR50)]  = write_audio;
+    io_write_table[IO(NR51)]  = write_audio;
+    io_write_table[IO(NR52)]  = write_audio;
     
     // DMA
-    memory_write_table[DMA]   = dma_handler;
+    io_write_table[IO(DMA)]   = dma_handler;
 
     // BIOS Latch
-    memory_write_table[BIOS]  = write_bios;
+    io_write_table[IO(BIOS)]  = write_bios;
+
+    // WRAM and VRAM Banks
+    io_write_table[IO(SVBK)]  = write_svbk;
+    io_write_table[IO(VBK)]   = write_vbk;
+
+    // Speed Switch
+    io_write_table[IO(KEY1)]  = write_key1;
     
     // HDMA
-    memory_write_table[HDMA5] = hdma_handler;
+    io_write_table[IO(HDMA5)] = hdma_handler;
 
     // Background Palette
-    memory_read_table[BCPD]   = read_bcpd;
-    memory_write_table[BCPD]  = write_bcpd;
+    io_read_table[IO(BCPD)]   = read_bcpd;
+    io_write_table[IO(BCPD)]  = write_bcpd;
     
     // Object Palette
-    memory_read_table[OCPD]   = read_ocpd;
-    memory_write_table[OCPD]  = write_ocpd;
+    io_read_table[IO(OCPD)]   = read_ocpd;
+    io_write_table[IO(OCPD)]  = write_ocpd;
 
     // Joypad
-    memory_read_table[JOYP]   = read_joypad;
-    memory_write_table[JOYP]  = write_joypad;
+    io_read_table[IO(JOYP)]   = read_joypad;
+    io_write_table[IO(JOYP)]  = write_joypad;
 
     // IO Ranges
     for (int i = WAVE_RAM_START; i <= WAVE_RAM_END; i++)
     {
-        memory_read_table[i]  = read_wave_ram;
-        memory_write_table[i] = write_wave_ram;
+        io_read_table[IO(i)]  = read_wave_ram;
+        io_write_table[IO(i)] = write_wave_ram;
     }
 }
 
 static void init_masks()
 {
     // Channel 1
-    memory_mask_table[NR10] = 0x80;
-    memory_mask_table[NR11] = 0x3F;
-    memory_mask_table[NR12] = 0x00;
-    memory_mask_table[NR13] = 0xFF;
-    memory_mask_table[NR14] = 0xBF;
+    io_mask_table[IO(NR10)] = 0x80;
+    io_mask_table[IO(NR11)] = 0x3F;
+    io_mask_table[IO(NR12)] = 0x00;
+    io_mask_table[IO(NR13)] = 0xFF;
+    io_mask_table[IO(NR14)] = 0xBF;
     // Channel 2
-    memory_mask_table[NR20] = 0xFF;
-    memory_mask_table[NR21] = 0x3F;
-    memory_mask_table[NR22] = 0x00;
-    memory_mask_table[NR23] = 0xFF;
-    memory_mask_table[NR24] = 0xBF;
+    io_mask_table[IO(NR20)] = 0xFF;
+    io_mask_table[IO(NR21)] = 0x3F;
+    io_mask_table[IO(NR22)] = 0x00;
+    io_mask_table[IO(NR23)] = 0xFF;
+    io_mask_table[IO(NR24)] = 0xBF;
     // Channel 3
-    memory_mask_table[NR30] = 0x7F;
-    memory_mask_table[NR31] = 0xFF;
-    memory_mask_table[NR32] = 0x9F;
-    memory_mask_table[NR33] = 0xFF;
-    memory_mask_table[NR34] = 0xBF;
+    io_mask_table[IO(NR30)] = 0x7F;
+    io_mask_table[IO(NR31)] = 0xFF;
+    io_mask_table[IO(NR32)] = 0x9F;
+    io_mask_table[IO(NR33)] = 0xFF;
+    io_mask_table[IO(NR34)] = 0xBF;
     // Channel 4
-    memory_mask_table[NR40] = 0xFF;
-    memory_mask_table[NR41] = 0xFF;
-    memory_mask_table[NR42] = 0x00;
-    memory_mask_table[NR43] = 0x00;
-    memory_mask_table[NR44] = 0xBF;
+    io_mask_table[IO(NR40)] = 0xFF;
+    io_mask_table[IO(NR41)] = 0xFF;
+    io_mask_table[IO(NR42)] = 0x00;
+    io_mask_table[IO(NR43)] = 0x00;
+    io_mask_table[IO(NR44)] = 0xBF;
     // Global Audio Registers
-    memory_mask_table[NR50] = 0x00;
-    memory_mask_table[NR51] = 0x00;
-    memory_mask_table[NR52] = 0x70;
+    io_mask_table[IO(NR50)] = 0x00;
+    io_mask_table[IO(NR51)] = 0x00;
+    io_mask_table[IO(NR52)] = 0x70;
 
     for (int index = (NR52 + 1); index < WAVE_RAM_START; index++)
-        memory_mask_table[index] = 0xFF;
+        io_mask_table[IO(index)] = 0xFF;
 }
 
 EmuMemory *init_memory()
@@ -631,10 +1033,16 @@ EmuMemory *init_memory()
     // OAM
     mem->oam = (uint8_t*) malloc(OAM_SIZE * sizeof(uint8_t));
     memset(mem->oam, 0, WAVE_RAM_SIZE);
+
+    // Decode Cache Code Map
+    mem->code_map = (bool*) calloc(CODE_MAP_SIZE, sizeof(bool));
  
     init_tables();
     init_masks();
 
+    remap_vram(mem);
+    remap_wram(mem);
+
     return mem;
 }
 
@@ -660,4 +1068,5 @@ void tidy_memory(EmuMemory **mem)
     free((*mem)->wram); (*mem)->wram = NULL;
 
     free((*mem)->wave_ram); (*mem)->wave_ram = NULL;
+    free((*mem)->code_map); (*mem)->code_map = NULL;
 }
\ No newline at end of file
@@ -9,18 +9,21 @@
 #include "core/mmu.h"
 #include "core/cpu.h"
 #include "core/ppu.h"
+#include "core/scheduler.h"
 
 #include "util/common.h"
-#include "util/circular_queue.h"
+#include "util/pixel_fifo.h"
+#include "util/tile_decode.h"
 
-#define FRAME_SIZE GBC_WIDTH * GBC_HEIGHT * sizeof(uint32_t)
+#define FRAME_SIZE GBC_WIDTH * GBC_HEIGHT * sizeof(uint32_t) // Widest format.
 
-static uint32_t        *gbc_lcd;
-static uint32_t *disabled_frame;
+static uint8_t         *gbc_lcd;
+static uint8_t  *disabled_frame;
+static uint32_t   skipped_line[GBC_WIDTH]; // FIFO output of frames not drawn.
 
-static Queue          *oam_fifo;
-static Queue          *bgw_fifo;
-static Queue          *obj_fifo;
+static ObjectFifo      oam_fifo;
+static PixelFifo       bgw_fifo;
+static PixelFifo       obj_fifo;
 
 static uint8_t scx_penalty(PPU *ppu)
 {
@@ -78,14 +81,18 @@ static inline void lock_oam(EmuMemory *mem)
 
 static inline void unlock_vram(EmuMemory *mem)
 {
+    sync_vram_dma(mem);
     mem-> vram_read_blocked = false;
     mem->vram_write_blocked = false;
+    remap_vram(mem);
 }
 
 static inline void lock_vram(EmuMemory *mem)
 {
+    sync_vram_dma(mem);
     mem-> vram_read_blocked = true;
     mem->vram_write_blocked = true;
+    remap_vram(mem);
 }
 
 // Drawing
@@ -114,14 +121,89 @@ static uint32_t get_dmg_shade(uint8_t id)
     return result;
 }
 
-static uint8_t get_color_id(uint8_t lsb, uint8_t msb, bool x_flip, uint8_t bit_index)
+static uint32_t encode_color(PPU *ppu, uint32_t argb, uint8_t index)
 {
-    uint8_t shift = x_flip ? bit_index : (7 - bit_index);
+    uint8_t   red = (argb >> (BYTE * 2)) & LOWER_BYTE_MASK;
+    uint8_t green = (argb >> (BYTE * 1)) & LOWER_BYTE_MASK;
+    uint8_t  blue =  argb                & LOWER_BYTE_MASK;
 
-    uint8_t lo = (lsb >> shift) & 0x1;
-    uint8_t hi = (msb >> shift) & 0x1;
+    switch(ppu->frame_format)
+    {
+        case FRAME_ARGB8888:  return argb;
+        case FRAME_RGB565:    return ((red >> 3) << 11) | ((green >> 2) << 5) | (blue >> 3);
+        case FRAME_INDEXED:   return index;
+        case FRAME_GRAYSCALE: return ((red * 77) + (green * 150) + (blue * 29)) >> 8; // BT.601 weights.
+    }
+
+    return argb;
+}
+
+static inline void store_pixel(PPU *ppu, uint8_t *line, uint8_t lx, uint32_t value)
+{
+    switch(ppu->pixel_bytes)
+    {
+        case 1:  line[lx] = (uint8_t) value;                break;
+        case 2:  ((uint16_t*) line)[lx] = (uint16_t) value; break;
+        default: ((uint32_t*) line)[lx] = value;            break;
+    }
+}
+
+static inline uint8_t *lcd_line(PPU *ppu)
+{
+    return &gbc_lcd[(*ppu->ly) * GBC_WIDTH * ppu->pixel_bytes];
+}
+
+// Palette Cache
+
+static void resolve_cram_color(PPU *ppu, bool is_obj, uint8_t palette, uint8_t color)
+{
+    uint8_t lsb = read_cram(ppu->mem, is_obj, palette, color, 0);
+    uint8_t msb = read_cram(ppu->mem, is_obj, palette, color, 1);
+
+    uint32_t *slots = is_obj ? ppu->cgb_colors.obj : ppu->cgb_colors.bgw;
+    uint8_t    slot = (palette << 2) | color;
+
+    slots[slot] = encode_color(ppu, get_argb(lsb, msb), (is_obj ? PALETTE_SLOTS : 0) + slot);
+}
 
-    return (hi << 1) | lo;
+static void resolve_dmg_palette(PPU *ppu, uint32_t *slots, uint8_t value)
+{
+    for (uint8_t color = 0; color < 4; color++)
+    {
+        uint8_t shade = (value >> (2 * color)) & LOWER_2_MASK;
+        slots[color] = encode_color(ppu, get_dmg_shade(shade), shade);
+    }
+}
+
+void refresh_cram_color(PPU *ppu, bool is_obj, uint8_t index) // Index into BG or OBJ CRAM.
+{
+    resolve_cram_color(ppu, is_obj, (index >> 3) & LOWER_3_MASK, (index >> 1) & LOWER_2_MASK);
+}
+
+void refresh_dmg_palette(PPU *ppu, uint16_t address)
+{
+    switch(address)
+    {
+        case BGP:  resolve_dmg_palette(ppu, &ppu->dmg_colors.bgw[0], *ppu->bgp);  break;
+        case OBP0: resolve_dmg_palette(ppu, &ppu->dmg_colors.obj[0], *ppu->opd0); break;
+        case OBP1: resolve_dmg_palette(ppu, &ppu->dmg_colors.obj[4], *ppu->opd1); break;
+    }
+}
+
+static void resolve_palettes(PPU *ppu)
+{
+    for (uint8_t palette = 0; palette < TILE_SIZE; palette++)
+    {
+        for (uint8_t color = 0; color < 4; color++)
+        {
+            resolve_cram_color(ppu, false, palette, color);
+            resolve_cram_color(ppu,  true, palette, color);
+        }
+    }
+
+    refresh_dmg_palette(ppu, BGP);
+    refresh_dmg_palette(ppu, OBP0);
+    refresh_dmg_palette(ppu, OBP1);
 }
 
 static bool drawing_window(PPU *ppu)
@@ -134,7 +216,7 @@ static bool obj_rendering_triggered(PPU *ppu)
 {
     bool obj_enabled = (((*ppu->lcdc) & BIT_1_MASK) != 0);
 
-    OamObject *obj = (OamObject*) peek(oam_fifo);
+    OamObject *obj = peek_object(&oam_fifo);
 
     if (obj == NULL || !obj_enabled) return false;
 
@@ -143,44 +225,28 @@ static bool obj_rendering_triggered(PPU *ppu)
     return (lx >= obj->x);
 }
 
-static uint32_t get_obj_pixel_color(PPU *ppu, GbcPixel *pixel)
+static inline uint32_t get_obj_pixel_color(PPU *ppu, uint8_t color, uint8_t attr)
 {
-    if(ppu->cart->is_gbc)
-    {
-        uint8_t lsb = read_cram(ppu->mem, true, pixel->cgb_palette, pixel->color, 0);
-        uint8_t msb = read_cram(ppu->mem, true, pixel->cgb_palette, pixel->color, 1);
-        return get_argb(lsb, msb); 
-    }
-    else
-    {
-        uint8_t opd = (pixel->dmg_palette) ? *ppu->opd1 : *ppu->opd0;
-        uint8_t cid = (opd >> (2 * pixel->color)) & LOWER_2_MASK;
-        return get_dmg_shade(cid);
-    }
+    uint8_t palette = ppu->cart->is_gbc ? (attr & LOWER_3_MASK) : ((attr >> 4) & BIT_0_MASK);
+    return ppu->colors->obj[(palette << 2) | color];
 }
 
-static uint32_t get_bgw_pixel_color(PPU *ppu, GbcPixel *pixel)
+static inline uint32_t get_bgw_pixel_color(PPU *ppu, uint8_t color, uint8_t attr)
 {
-    if(ppu->cart->is_gbc)
-    {
-        uint8_t lsb = read_cram(ppu->mem, false, pixel->cgb_palette, pixel->color, 0);
-        uint8_t msb = read_cram(ppu->mem, false, pixel->cgb_palette, pixel->color, 1);
-        return get_argb(lsb, msb); 
-    }
-    else
-    {
-        uint8_t cid = ((*ppu->bgp) >> (2 * pixel->color)) & LOWER_2_MASK;
-        return get_dmg_shade(cid);
-    }
+    uint8_t palette = ppu->cart->is_gbc ? (attr & LOWER_3_MASK) : 0;
+    return ppu->colors->bgw[(palette << 2) | color];
 }
 
-static uint32_t merge_obj_bgw(PPU *ppu, GbcPixel *bgw, GbcPixel *obj)
+static uint32_t merge_obj_bgw(PPU *ppu, uint8_t bgw, uint8_t obj)
 {   
-    if (obj->color == 0) return get_bgw_pixel_color(ppu, bgw);
-    if (bgw->color == 0) return get_obj_pixel_color(ppu, obj);
+    uint8_t bgw_color = bgw_fifo.color[bgw], bgw_attr = bgw_fifo.attr[bgw];
+    uint8_t obj_color = obj_fifo.color[obj], obj_attr = obj_fifo.attr[obj];
+
+    if (obj_color == 0) return get_bgw_pixel_color(ppu, bgw_color, bgw_attr);
+    if (bgw_color == 0) return get_obj_pixel_color(ppu, obj_color, obj_attr);
 
     bool master_prio = ppu->cart->is_gbc ? (((*ppu->lcdc) & BIT_0_MASK) != 0) : false;
-    uint8_t code = (master_prio << 2) | (obj->priority << 1) | bgw->priority;
+    uint8_t code = (master_prio << 2) | ((obj_attr >> 6) & BIT_1_MASK) | (bgw_attr >> 7);
 
     switch(code) // Truth table from Pandocs. 
     {
@@ -189,29 +255,31 @@ static uint32_t merge_obj_bgw(PPU *ppu, GbcPixel *bgw, GbcPixel *obj)
         case 2:
         case 3:
         case 4:
-            return get_obj_pixel_color(ppu, obj);
+            return get_obj_pixel_color(ppu, obj_color, obj_attr);
         
         case 5:
         case 6:
         case 7:
-            return get_bgw_pixel_color(ppu, bgw);
+            return get_bgw_pixel_color(ppu, bgw_color, bgw_attr);
     }
     
 }
 
 static void draw_pixel_lcd(PPU *ppu)
 {
-    if (!is_empty(bgw_fifo) && !is_empty(obj_fifo))
+    uint8_t *line = ppu->skip_frame ? (uint8_t*) skipped_line : lcd_line(ppu);
+
+    if ((bgw_fifo.size != 0) && (obj_fifo.size != 0))
     {
-        GbcPixel *bgw = dequeue(bgw_fifo); 
-        GbcPixel *obj = dequeue(obj_fifo);
-        gbc_lcd[((*ppu->ly) * GBC_WIDTH) + ppu->lx] = merge_obj_bgw(ppu, bgw, obj);
+        uint8_t bgw = pop_pixel(&bgw_fifo); 
+        uint8_t obj = pop_pixel(&obj_fifo);
+        store_pixel(ppu, line, ppu->lx, merge_obj_bgw(ppu, bgw, obj));
         ppu->lx++;
     }
-    else if (!is_empty(bgw_fifo))
+    else if (bgw_fifo.size != 0)
     {
-        GbcPixel *bgw = dequeue(bgw_fifo);
-        gbc_lcd[((*ppu->ly) * GBC_WIDTH) + ppu->lx] = get_bgw_pixel_color(ppu, bgw);
+        uint8_t bgw = pop_pixel(&bgw_fifo);
+        store_pixel(ppu, line, ppu->lx, get_bgw_pixel_color(ppu, bgw_fifo.color[bgw], bgw_fifo.attr[bgw]));
         ppu->lx++;
     }
 
@@ -238,6 +306,28 @@ static uint16_t bgw_tile_data_address(uint8_t index, uint8_t lcdc, uint8_t row)
     return base + (row * 2);  // Two bytes per row
 }
 
+// Tile Cache
+
+static void decode_tile(PPU *ppu, uint8_t bank, uint16_t index)
+{
+    DecodedTile *tile = &ppu->tile_cache[bank][index];
+
+    decode_tile_rows(&ppu->mem->vram[bank][index * TILE_DATA_BYTES], &tile->rows[0][0][0], &tile->rows[1][0][0]);
+
+    ppu->tile_dirty[bank][index] = false;
+}
+
+static const uint8_t *decoded_row(PPU *ppu, uint8_t bank, uint16_t address, bool x_flip) // Address of the row's low byte.
+{
+    uint16_t index = (address - B0_ADDRESS_START) >> 4;
+    uint8_t    row = (address >> 1) & (TILE_SIZE - 1);
+
+    if (ppu->tile_dirty[bank][index])
+        decode_tile(ppu, bank, index);
+
+    return ppu->tile_cache[bank][index].rows[x_flip][row];
+}
+
 static void encode_tile(PPU *ppu, Tile *tile, uint8_t mask)
 {
     uint16_t map_base = ((*ppu->lcdc & mask) != 0) ? TM1_ADDRESS_START : TM0_ADDRESS_START;
@@ -255,11 +345,10 @@ static void encode_tile(PPU *ppu, Tile *tile, uint8_t mask)
         bank = (tile->attr & BIT_3_MASK) >> 3;
     }
 
-    // Get MSB and LSB data from VRAM.
-    uint8_t index = read_vram_bank(ppu->mem, 0, address);
-    address   = bgw_tile_data_address(index, *ppu->lcdc, tile->row);
-    tile->lsb = read_vram_bank(ppu->mem, bank, address);
-    tile->msb = read_vram_bank(ppu->mem, bank, address + 1);
+    // Decoded row from the tile cache.
+    uint8_t   index = read_vram_bank(ppu->mem, 0, address);
+    address         = bgw_tile_data_address(index, *ppu->lcdc, tile->row);
+    tile->   pixels = decoded_row(ppu, bank, address, (tile->attr & BIT_5_MASK) != 0);
 }
 
 static Tile get_win_tile(PPU *ppu)
@@ -292,12 +381,10 @@ static Tile get_bg_tile(PPU *ppu)
     return tile;
 }
 
-static Tile get_obj_tile(PPU *ppu)
+static Tile get_obj_tile(PPU *ppu, OamObject *obj)
 {
     Tile tile = {0};
 
-    OamObject *obj =  (OamObject*) peek(oam_fifo);
-
     uint8_t    row = ((*ppu->ly + 16) - obj->y);
     bool   stacked = (((*ppu->lcdc) & BIT_2_MASK) != 0);
     uint8_t height = stacked ? 16 : 8;
@@ -306,145 +393,383 @@ static Tile get_obj_tile(PPU *ppu)
     row = (obj->y_flip) ? (height - 1 - row) : row;
 
     uint16_t address = B0_ADDRESS_START + (index * 16) + (row * 2);
-    tile.lsb = read_vram_bank(ppu->mem, obj->bank, address);
-    tile.msb = read_vram_bank(ppu->mem, obj->bank, address + 1);
+    tile.pixels = decoded_row(ppu, obj->bank, address, obj->x_flip);
 
     return tile;
 }
 
+/*
+    The objects of every visible line are listed up front, first ten in
+    OAM order as the scan picks them and sorted by X as the FIFO takes
+    them. The lists hold until OAM is written or LCDC.2 flips, which for
+    most games means one rebuild per frame after the DMA.
+*/
+static void build_sprite_lines(PPU *ppu, bool stacked)
+{
+    uint8_t *oam = ppu->mem->oam;
+    uint8_t  height = (stacked) ? 16 : 8;
+
+    for (uint8_t ly = 0; ly < GBC_HEIGHT; ly++)
+        ppu->sprite_lines[ly].count = 0;
+
+    for (uint8_t entry = 0; entry < (OAM_SIZE / OAM_ENTRY_SIZE); entry++)
+    {
+        int16_t top = oam[entry * OAM_ENTRY_SIZE] - 16; // y_screen
+
+        for (int16_t ly = (top < 0) ? 0 : top; (ly < (top + height)) && (ly < GBC_HEIGHT); ly++)
+        {
+            SpriteLine *line = &ppu->sprite_lines[ly];
+            if (line->count == OBJS_PER_SCANLINE) continue;
+
+            uint8_t x = oam[(entry * OAM_ENTRY_SIZE) + 1];
+            uint8_t i = line->count++;
+
+            for (; (i > 0) && (oam[(line->entry[i - 1] * OAM_ENTRY_SIZE) + 1] > x); i--) // Stable, OAM order breaks ties.
+                line->entry[i] = line->entry[i - 1];
+
+            line->entry[i] = entry;
+        }
+    }
+
+    ppu->   oam_dirty = false;
+    ppu->sprites_tall = stacked;
+}
+
 static void oam_scan(PPU *ppu)
 {
-    reset_queue(oam_fifo);
+    reset_object_fifo(&oam_fifo);
     
-    uint16_t address = OAM_START;
     bool stacked = (((*ppu->lcdc) & BIT_2_MASK) != 0);
 
-    while((address <= OAM_END) && (oam_fifo->size < 10))
-    {
-        uint8_t       y_pos = read_memory(ppu->mem, address); // y_screen + 16
-        uint8_t      height = (stacked) ? 16 : 8;
-        uint8_t          ly = (*ppu->ly) + 16; // Object domain
-        bool    on_scanline = (ly >= y_pos) && ((ly - y_pos) < height);
+    sync_oam_dma(ppu->mem); // Bytes a running DMA has already delivered.
 
-        if (on_scanline)
-        {
-            OamObject obj = (OamObject) {0}; 
+    if (ppu->oam_dirty || (stacked != ppu->sprites_tall))
+        build_sprite_lines(ppu, stacked);
 
-            uint8_t       x_pos = read_memory(ppu->mem, address + 1); // x_screen + 8
-            uint8_t  tile_index = read_memory(ppu->mem, address + 2);
-            uint8_t  attributes = read_memory(ppu->mem, address + 3);
+    SpriteLine *line = &ppu->sprite_lines[*ppu->ly];
 
-            obj.    oam_address = address;
-            obj.              x = x_pos; 
-            obj.              y = y_pos;
-            obj.     tile_index = tile_index;
+    for (uint8_t i = 0; i < line->count; i++)
+    {
+        uint16_t    address = line->entry[i] * OAM_ENTRY_SIZE;
+        uint8_t  attributes = ppu->mem->oam[address + 3];
 
-            obj.       priority = (attributes & BIT_7_MASK) != 0;
-            obj.         y_flip = (attributes & BIT_6_MASK) != 0;
-            obj.         x_flip = (attributes & BIT_5_MASK) != 0;
-            obj.    dmg_palette = (attributes & BIT_4_MASK) != 0;
-            obj.           bank = ((attributes & BIT_3_MASK) != 0) ?  1 : 0;
-            obj.    cgb_palette = (uint8_t) (attributes & LOWER_3_MASK);
+        OamObject obj = (OamObject) {0}; 
 
-            enqueue_object(oam_fifo, &obj);
-        }
+        obj.    oam_address = OAM_START + address;
+        obj.              y = ppu->mem->oam[address];
+        obj.              x = ppu->mem->oam[address + 1];
+        obj.     tile_index = ppu->mem->oam[address + 2];
 
-        address += OAM_ENTRY_SIZE;
-    }
+        obj.       priority = (attributes & BIT_7_MASK) != 0;
+        obj.         y_flip = (attributes & BIT_6_MASK) != 0;
+        obj.         x_flip = (attributes & BIT_5_MASK) != 0;
+        obj.    dmg_palette = (attributes & BIT_4_MASK) != 0;
+        obj.           bank = ((attributes & BIT_3_MASK) != 0) ?  1 : 0;
+        obj.    cgb_palette = (uint8_t) (attributes & LOWER_3_MASK);
 
-    sort_oam_by_xpos(oam_fifo);
+        push_object(&oam_fifo, &obj);
+    }
 }
 
 // Pixel Pipeline
 
-static uint8_t get_tile_pixel_color(Tile tile, uint8_t shift, bool x_flip)
+static inline uint8_t obj_pixel_attr(OamObject *obj)
+{
+    return (obj->priority << 7) | (obj->dmg_palette << 4) | obj->cgb_palette;
+}
+
+static void push_bgw_row(Tile tile, PixelFifo *fifo, uint8_t offset)
+{
+    push_pixel_row(fifo, tile.pixels, tile.attr & PIXEL_ATTR_MASK);
+    drop_pixels(fifo, offset);                              // Fine scroll.
+}
+
+static void push_obj_row(PPU *ppu, Tile tile, PixelFifo *fifo)
+{
+    OamObject *obj = peek_object(&oam_fifo);
+
+    ppu->penalty += obj_penalty(ppu, obj);                  // Calculate drawing penalty.
+
+    merge_pixel_row(fifo, tile.pixels, obj_pixel_attr(obj)); // Replace transparent pixels.
+    drop_pixels(fifo, (ppu->lx + TILE_SIZE) - obj->x);      // Chop a little off the top.
+
+    pop_object(&oam_fifo);                                  // Consume object.
+}
+
+static void pixel_pipeline_step(PPU *ppu)
 {
-    uint8_t lsb, msb;
+    while (obj_rendering_triggered(ppu))
+    {
+        Tile tile = get_obj_tile(ppu, peek_object(&oam_fifo));
+        push_obj_row(ppu, tile, &obj_fifo);
+    }
 
-    if (x_flip)
+    if (drawing_window(ppu) && !ppu->win_rendering)
     {
-        lsb = (tile.lsb >> shift) & BIT_0_MASK;
-        msb = (tile.msb >> shift) & BIT_0_MASK;
+        reset_pixel_fifo(&bgw_fifo);
+        ppu->penalty += 6;
+        ppu->win_rendering = true;
     }
-    else
+    
+    if (bgw_fifo.size == 0)
     {
-        lsb = (tile.lsb >> (TILE_SIZE - 1 - shift)) & BIT_0_MASK;
-        msb = (tile.msb >> (TILE_SIZE - 1 - shift)) & BIT_0_MASK;
+        Tile tile = ppu->win_rendering ? get_win_tile(ppu) : get_bg_tile(ppu);
+        uint8_t offset = ((ppu->sc_tile == 0) && !ppu->win_rendering) ? ((*ppu->scx) % 8) : 0; 
+        push_bgw_row(tile, &bgw_fifo, offset);
+        ppu->sc_tile++;
     }
 
-    return ((msb << 1) | lsb);
+    draw_pixel_lcd(ppu);
 }
 
-static void push_bgw_row(Tile tile, Queue *fifo, uint8_t offset)
+// Scanline Renderer
+
+/*
+    Lines whose registers hold still through mode 3 are drawn in one pass
+    at the start of HBlank. The pass follows the FIFO rule for rule, with
+    tiles decoded eight pixels at a time. A write to any register the
+    FIFO samples mid-line replays the dots drawn so far through the FIFO,
+    which then finishes the line.
+*/
+static uint8_t line_penalty(PPU *ppu) // Mode 3 length the FIFO would reach.
 {
-    bool   x_flip = ((tile.attr & BIT_5_MASK) != 0);
+    uint8_t penalty = scx_penalty(ppu);
+    uint8_t    lcdc = *ppu->lcdc;
 
-    for (uint8_t i = offset; i < TILE_SIZE; i++)
+    if ((lcdc & BIT_1_MASK) != 0)
     {
-        GbcPixel    pixel = {0};
-        pixel.      color = get_tile_pixel_color(tile, i, x_flip);
-        pixel.   priority = ((tile.attr & BIT_7_MASK) != 0);
-        pixel.cgb_palette = tile.attr & LOWER_3_MASK;
-        enqueue_pixel(fifo, &pixel);
+        for (uint8_t i = 0; i < oam_fifo.size; i++)
+            penalty += obj_penalty(ppu, object_at(&oam_fifo, i));
+
+        memset(ppu->tile_considered, 0, sizeof(ppu->tile_considered));
     }
+
+    bool window = ((lcdc & BIT_5_MASK) != 0) && ((*ppu->ly) >= (*ppu->wy)) && ((*ppu->wx) <= (GBC_WIDTH + 6));
+    
+    if (window) 
+        penalty += 6;
+
+    return penalty;
 }
 
-static uint8_t push_obj_row(PPU *ppu, Tile tile, Queue *fifo)
+static void fetch_bgw_line(PPU *ppu, uint8_t *colors, uint8_t *attrs)
 {
-    OamObject *obj = dequeue(oam_fifo);     // Consume object.
-
-    ppu->penalty += obj_penalty(ppu, obj);  // Calculate drawing penalty.
+    uint8_t  scx = *ppu->scx;
+    uint8_t   ly = *ppu->ly;
+    uint8_t   wx = *ppu->wx;
+    uint8_t    y = (*ppu->scy) + ly;
+    bool  window = ((*ppu->lcdc) & BIT_5_MASK) && (ly >= (*ppu->wy)) && (wx <= (GBC_WIDTH + 6));
+    uint8_t stop = !window ? GBC_WIDTH : ((wx < 7) ? 0 : (wx - 7)); // First window pixel.
 
-    GbcPixel pixel = {0};                   // Transparent pixel.
+    uint8_t   lx = 0;
 
-    while(fifo->size < TILE_SIZE)           // Pad up to 8.
+    for (uint8_t sc_tile = 0; lx < stop; sc_tile++)
     {
-        enqueue_pixel(fifo, &pixel);
+        Tile tile = {0};
+        tile.  x = ((scx / TILE_SIZE) + sc_tile) % GRID_SIZE;
+        tile.  y = (y / TILE_SIZE) % GRID_SIZE;
+        tile.row = y % TILE_SIZE;
+        encode_tile(ppu, &tile, BIT_3_MASK);
+
+        for (uint8_t i = (sc_tile == 0) ? (scx % TILE_SIZE) : 0; (i < TILE_SIZE) && (lx < stop); i++, lx++)
+        {
+            colors[lx] = tile.pixels[i];
+             attrs[lx] = tile.attr & PIXEL_ATTR_MASK;
+        }
     }
 
-    for (uint8_t i = 0; i < TILE_SIZE; i++) // Replace transparent pixels.
+    uint8_t win_y = ly - (*ppu->wy);
+
+    for (uint8_t column = 0; lx < GBC_WIDTH; column++)
     {
-        GbcPixel *current = dequeue(fifo);
+        Tile tile = {0};
+        tile.  x = column;
+        tile.  y = win_y / TILE_SIZE;
+        tile.row = win_y % TILE_SIZE;
+        encode_tile(ppu, &tile, BIT_6_MASK);
 
-        pixel.      color = get_tile_pixel_color(tile, i, obj->x_flip);
-        pixel.   priority = obj->priority;
-        pixel.dmg_palette = obj->dmg_palette;
-        pixel.cgb_palette = obj->cgb_palette;
-        
-        current = (current->color == 0) ? &pixel : current;
-        enqueue_pixel(fifo, current);
+        for (uint8_t i = 0; (i < TILE_SIZE) && (lx < GBC_WIDTH); i++, lx++)
+        {
+            colors[lx] = tile.pixels[i];
+             attrs[lx] = tile.attr & PIXEL_ATTR_MASK;
+        }
     }
+}
+
+static void render_scanline(PPU *ppu)
+{
+    uint8_t colors[GBC_WIDTH], attrs[GBC_WIDTH];
+
+    fetch_bgw_line(ppu, colors, attrs);
+
+    bool obj_enabled = (((*ppu->lcdc) & BIT_1_MASK) != 0);
+    bool master_prio = ppu->cart->is_gbc && (((*ppu->lcdc) & BIT_0_MASK) != 0);
+    uint8_t    *line = lcd_line(ppu);
 
-    for (uint8_t i = 0; i < ((ppu->lx + 8) - obj->x); i++)    // Chop a little off the top.
+    PixelFifo objs;
+    reset_pixel_fifo(&objs);
+
+    for (uint8_t lx = 0; lx < GBC_WIDTH; lx++)
     {
-        dequeue(fifo);
+        while (obj_enabled && (oam_fifo.size != 0))
+        {
+            OamObject *obj = peek_object(&oam_fifo);
+
+            if ((lx + TILE_SIZE) < obj->x) break;
+
+            Tile tile = get_obj_tile(ppu, obj);
+            merge_pixel_row(&objs, tile.pixels, obj_pixel_attr(obj));
+            drop_pixels(&objs, (lx + TILE_SIZE) - obj->x);
+            pop_object(&oam_fifo); // Consumed, as the FIFO leaves it.
+        }
+
+        if (objs.size == 0)
+        {
+            store_pixel(ppu, line, lx, get_bgw_pixel_color(ppu, colors[lx], attrs[lx]));
+            continue;
+        }
+
+        uint8_t slot = pop_pixel(&objs);
+        uint8_t obj_color = objs.color[slot], obj_attr = objs.attr[slot];
+
+        uint8_t code = (master_prio << 2) | ((obj_attr >> 6) & BIT_1_MASK) | (attrs[lx] >> 7);
+
+        bool obj_wins = (obj_color != 0) && ((colors[lx] == 0) || (code <= 4)); // Truth table from Pandocs.
+
+        store_pixel(ppu, line, lx, obj_wins ? get_obj_pixel_color(ppu, obj_color, obj_attr) : get_bgw_pixel_color(ppu, colors[lx], attrs[lx]));
     }
+
+    ppu->          lx = GBC_WIDTH;
+    ppu->sc_rendering =     false;
 }
 
-static void pixel_pipeline_step(PPU *ppu)
+static void skip_scanline(PPU *ppu) // Mode 3 length was already set by line_penalty.
 {
-    while (obj_rendering_triggered(ppu))
-    {
-        Tile tile = get_obj_tile(ppu);
-        push_obj_row(ppu, tile, obj_fifo);
-    }
+    bool obj_enabled = (((*ppu->lcdc) & BIT_1_MASK) != 0);
 
-    if (drawing_window(ppu) && !ppu->win_rendering)
-    {
-        reset_queue(bgw_fifo);
-        ppu->penalty += 6;
-        ppu->win_rendering = true;
-    }
-    
-    if (is_empty(bgw_fifo))
+    while (obj_enabled && (oam_fifo.size != 0) && (peek_object(&oam_fifo)->x < (GBC_WIDTH + TILE_SIZE)))
+        pop_object(&oam_fifo); // Consumed, as the FIFO leaves it.
+
+    ppu->          lx = GBC_WIDTH;
+    ppu->sc_rendering =     false;
+}
+
+// Dot Scheduling
+
+/*
+    The PPU only runs the dots that do something: mode changes, the end
+    of a line and, while mode 3 goes through the FIFO, each of its dots.
+    Those are PPU events. The dots in between are only counted, once an
+    event or a register access needs the line position.
+*/
+static void count_dots(PPU *ppu, uint64_t cycle) // None of the dots up to cycle change anything.
+{
+    uint16_t dots = (uint16_t) (cycle - ppu->dot_cycle);
+
+    ppu->   sc_dot += dots;
+    ppu->dot_cycle  = cycle;
+
+    if ((ppu->mode == DRAWING) && ppu->sc_rendering && ppu->line_batched)
+        ppu->deferred_dots += dots;
+}
+
+static inline void sync_dots(PPU *ppu)
+{
+    if (ppu->running) 
+        count_dots(ppu, ppu->sched->cycle);
+}
+
+static uint16_t next_event_dot(PPU *ppu) // Mirrors the dots check_mode acts on.
+{
+    uint16_t  dot = ppu->sc_dot;
+    uint16_t last = DOTS_PER_SCANLINE - 1;
+
+    if ((*ppu->ly) >= GBC_HEIGHT)
+        return (((*ppu->ly) == GBC_HEIGHT) && (dot == 0)) ? 0 : last;
+
+    if ((ppu->mode == DRAWING) && ppu->sc_rendering && !ppu->line_batched)
+        return dot;
+
+    const uint16_t marks[4] = { 0, 79, 80, 252 + ppu->penalty };
+    uint16_t        next = last;
+
+    for (uint8_t i = 0; i < 4; i++)
+        if ((marks[i] >= dot) && (marks[i] < next)) next = marks[i];
+
+    return next;
+}
+
+static void schedule_next_dot(PPU *ppu) // Dots must be counted up to the current cycle.
+{
+    schedule_event(ppu->sched, PPU_EVENT, 1 + next_event_dot(ppu) - ppu->sc_dot);
+}
+
+/*
+    Replays the dots of mode 3 so far through the FIFO before a register
+    the line depends on changes. The FIFO keeps the line from there on.
+*/
+void sync_scanline(PPU *ppu)
+{
+    if (!ppu->line_batched || (ppu->mode != DRAWING)) 
+        return;
+
+    sync_dots(ppu);
+
+    ppu->line_batched = false;
+    ppu->     penalty = ppu->base_penalty;
+
+    memset(ppu->tile_considered, 0, sizeof(ppu->tile_considered));
+
+    for (uint16_t i = 0; (i < ppu->deferred_dots) && ppu->sc_rendering; i++)
+        pixel_pipeline_step(ppu);
+
+    ppu->deferred_dots = 0;
+
+    schedule_next_dot(ppu); // Mode 3 now runs dot by dot.
+}
+
+void enable_line_batching(PPU *ppu, bool enabled)
+{
+    ppu->batch_enabled = enabled;
+}
+
+// Render Skipping
+
+/*
+    Frames that are not going to be shown still run every mode change,
+    interrupt and memory lock on time. Their lines take the batched path
+    for the mode 3 length but are never fetched or drawn, and gbc_lcd
+    keeps the last drawn frame. The choice is made as each frame starts.
+*/
+static void start_frame(PPU *ppu)
+{
+    bool due = false;
+
+    if (ppu->render_interval != 0)
     {
-        Tile tile = ppu->win_rendering ? get_win_tile(ppu) : get_bg_tile(ppu);
-        uint8_t offset = ((ppu->sc_tile == 0) && !ppu->win_rendering) ? ((*ppu->scx) % 8) : 0; 
-        push_bgw_row(tile, bgw_fifo, offset);
-        ppu->sc_tile++;
+        ppu->render_phase = (ppu->render_phase + 1) % ppu->render_interval;
+        due = (ppu->render_phase == 0);
     }
 
-    draw_pixel_lcd(ppu);
+    ppu->   frame_skipped = ppu->skip_frame;
+    ppu->      skip_frame = !due && !ppu->render_requested;
+    ppu->render_requested = false;
+}
+
+void set_render_interval(PPU *ppu, uint8_t interval)
+{
+    ppu->render_interval = interval;
+    ppu->   render_phase =        0;
+}
+
+void request_frame_render(PPU *ppu) // Draws the next frame whatever the interval.
+{
+    ppu->render_requested = true;
+}
+
+bool last_frame_drawn(PPU *ppu)
+{
+    return !ppu->frame_skipped;
 }
 
 // Mode Handling
@@ -501,7 +826,6 @@ static inline void set_ppu_mode(PPU *ppu, PpuMode mode)
 static void enter_oam_mode(PPU *ppu)
 {
     // OAM Scan
-    unlock_oam(ppu->mem);
     oam_scan(ppu);
     lock_oam(ppu->mem);
     // Check for STAT interrupt. 
@@ -512,8 +836,8 @@ static void enter_oam_mode(PPU *ppu)
 
 static void enter_drawing_mode(PPU *ppu)
 {
-    reset_queue(bgw_fifo);
-    reset_queue(obj_fifo);
+    reset_pixel_fifo(&bgw_fifo);
+    reset_pixel_fifo(&obj_fifo);
     // Normalize scanline variables.
     ppu->      penalty = scx_penalty(ppu);
     ppu->      sc_tile =     0;
@@ -525,6 +849,13 @@ static void enter_drawing_mode(PPU *ppu)
     lock_vram(ppu->mem);
     // Reset object penalty tiles.
     memset(ppu->tile_considered, 0, sizeof(ppu->tile_considered));
+    // Defer the line to HBlank, with the length the FIFO would draw it in.
+    ppu->base_penalty  = ppu->penalty;
+    ppu->deferred_dots =            0;
+    ppu->line_batched  = ppu->batch_enabled || ppu->skip_frame;
+
+    if (ppu->line_batched) 
+        ppu->penalty = line_penalty(ppu);
     // Check for STAT interrupt.
     check_stat_irq(ppu, DRAWING);
     // Update STAT
@@ -533,6 +864,10 @@ static void enter_drawing_mode(PPU *ppu)
 
 static void enter_hblank_mode(PPU *ppu)
 {
+    if (ppu->line_batched && ppu->sc_rendering)
+        ppu->skip_frame ? skip_scanline(ppu) : render_scanline(ppu);
+
+    ppu->line_batched = false;
     // Unlock memory.
     unlock_oam(ppu->mem);
     unlock_vram(ppu->mem);
@@ -563,7 +898,10 @@ static bool next_scanline(PPU *ppu)
         check_stat_irq(ppu, COINCIDENCE);
 
     if (*ppu->ly == 0)
+    {
+        start_frame(ppu);
         return true;
+    }
 
     return false;
 }
@@ -585,6 +923,7 @@ static void check_mode(PPU *ppu)
             case 79: // Hardware quirk
                 ppu->mem->oam_write_blocked = false;
                 ppu->mem->vram_read_blocked = !ppu->init_sc;
+                remap_vram(ppu->mem);
                 break;
 
             case 80:
@@ -614,27 +953,37 @@ static void check_mode(PPU *ppu)
 
 // Driver
 
-bool ppu_dot(PPU *ppu) // Once per dot. 
+static void run_dot(PPU *ppu)
 {
-    bool frame_ready = false;
-
-    if (!ppu->running) return false;
-
     check_mode(ppu);
 
     if (++ppu->sc_dot == DOTS_PER_SCANLINE)
-        frame_ready = next_scanline(ppu);
+        ppu->frame_ready |= next_scanline(ppu);
     
     if ((ppu->mode == DRAWING) && ppu->sc_rendering)
-        pixel_pipeline_step(ppu); 
+    {
+        if (ppu->line_batched) 
+            ppu->deferred_dots++;
+        else
+            pixel_pipeline_step(ppu); 
+    }
+}
 
-    return frame_ready;
+void ppu_event(PPU *ppu) // Runs the dot of the current cycle.
+{
+    count_dots(ppu, ppu->sched->cycle - 1);
+    run_dot(ppu);
+
+    ppu->dot_cycle = ppu->sched->cycle;
+    schedule_next_dot(ppu);
 }
 
 // Info
 
 char *get_ppu_state(PPU *ppu, char *buffer, size_t size)
 {
+    sync_dots(ppu);
+
     snprintf(
         buffer, 
         size, 
@@ -653,6 +1002,8 @@ char *get_ppu_state(PPU *ppu, char *buffer, size_t size)
 
 static void write_lcdc(PPU *ppu, uint8_t value)
 {
+    sync_scanline(ppu);
+
     (*ppu->lcdc) = value;
     
     bool enabled = (((*ppu->lcdc) & BIT_7_MASK) != 0);
@@ -663,6 +1014,8 @@ static void write_lcdc(PPU *ppu, uint8_t value)
         ppu->  sc_dot =     0;
         *ppu->     ly =     0;
 
+        cancel_event(ppu->sched, PPU_EVENT);
+
         unlock_oam(ppu->mem);
         unlock_vram(ppu->mem);
 
@@ -684,6 +1037,9 @@ static void write_lcdc(PPU *ppu, uint8_t value)
         check_stat_irq(ppu, COINCIDENCE);
 
         set_ppu_mode(ppu, HBLANK);
+
+        ppu->dot_cycle = ppu->sched->cycle;
+        schedule_next_dot(ppu);
     }
 }
 
@@ -716,6 +1072,34 @@ void write_ppu_register(PPU *ppu, uint16_t address, uint8_t value)
 
 // Obtaining Frame
 
+static void fill_disabled_frame(PPU *ppu)
+{
+    uint32_t white = encode_color(ppu, WHITE, 0);
+
+    for (uint8_t ly = 0; ly < GBC_HEIGHT; ly++)
+        for (uint8_t lx = 0; lx < GBC_WIDTH; lx++)
+            store_pixel(ppu, &disabled_frame[ly * frame_pitch(ppu)], lx, white);
+}
+
+/*
+    Frames are written straight in the chosen format, row after row with
+    no padding. Best changed between frames; the lines already drawn in
+    the current frame keep the old format.
+*/
+void set_frame_format(PPU *ppu, FrameFormat format)
+{
+    ppu->frame_format = format;
+    ppu-> pixel_bytes = (format == FRAME_ARGB8888) ? 4 : (format == FRAME_RGB565) ? 2 : 1;
+
+    resolve_palettes(ppu);
+    fill_disabled_frame(ppu);
+}
+
+size_t frame_pitch(PPU *ppu) // Bytes per row.
+{
+    return GBC_WIDTH * ppu->pixel_bytes;
+}
+
 void *render_frame(PPU *ppu)
 {   
     if (ppu->frame_delay)
@@ -732,10 +1116,11 @@ void *render_frame(PPU *ppu)
 void link_ppu(PPU *ppu, GbcEmu *emu)
 {
     // Context
-    ppu->cart = emu->cart;
-    ppu-> emu = emu;
-    ppu-> mem = emu->mem;
-    ppu-> cpu = emu->cpu;
+    ppu-> cart = emu->cart;
+    ppu->  emu = emu;
+    ppu->  mem = emu->mem;
+    ppu->  cpu = emu->cpu;
+    ppu->sched = emu->sched;
 
     // Hardware Registers
     ppu->ly   = &(emu->mem->memory[LY]);   // Current Scanline
@@ -749,18 +1134,20 @@ void link_ppu(PPU *ppu, GbcEmu *emu)
     ppu->bgp  = &(emu->mem->memory[BGP]);  // DMG - Background Palette
     ppu->opd0 = &(emu->mem->memory[OBP0]); // DMG - Object Palette 0
     ppu->opd1 = &(emu->mem->memory[OBP1]); // DMG - Object Palette 1
+
+    ppu->colors = emu->cart->is_gbc ? &ppu->cgb_colors : &ppu->dmg_colors;
+    set_frame_format(ppu, ppu->frame_format);
 }
 
 static void init_pipeline()
 {
-    gbc_lcd = (uint32_t*) malloc(FRAME_SIZE);
+    gbc_lcd = (uint8_t*) malloc(FRAME_SIZE);
 
-    disabled_frame = (uint32_t*) malloc(FRAME_SIZE);
-    memset(disabled_frame, WHITE, FRAME_SIZE);
+    disabled_frame = (uint8_t*) malloc(FRAME_SIZE); // Filled per format.
 
-    oam_fifo = init_queue(OBJS_PER_SCANLINE, OBJECT);
-    bgw_fifo = init_queue(2 * TILE_SIZE, PIXEL);
-    obj_fifo = init_queue(TILE_SIZE, PIXEL);
+    reset_object_fifo(&oam_fifo);
+    reset_pixel_fifo(&bgw_fifo);
+    reset_pixel_fifo(&obj_fifo);
 }
 
 static void tidy_pipeline()
@@ -768,9 +1155,6 @@ static void tidy_pipeline()
     free(gbc_lcd);               gbc_lcd = NULL;
     free(disabled_frame); disabled_frame = NULL;
 
-    tidy_queue(oam_fifo);
-    tidy_queue(bgw_fifo);
-    tidy_queue(obj_fifo);
 }
 
 PPU *init_ppu()
@@ -779,13 +1163,34 @@ PPU *init_ppu()
 
     ppu->      penalty =     0;
     ppu->       sc_dot =     0;
+    ppu->    dot_cycle =     0;
     ppu->      running = false;
+    ppu->  frame_ready = false;
     ppu->win_rendering = false;
     ppu-> sc_rendering = false;
     ppu->stat_irq_line = false;
     ppu->      lyc_irq = false;
+    ppu->batch_enabled =  true;
+    ppu-> line_batched = false;
+    ppu->deferred_dots =     0;
+    ppu-> base_penalty =     0;
+
+    ppu->    frame_format = FRAME_ARGB8888;
+    ppu->     pixel_bytes =     4;
+
+    ppu-> render_interval =     1;
+    ppu->    render_phase =     0;
+    ppu->render_requested = false;
+    ppu->      skip_frame = false;
+    ppu->   frame_skipped = false;
+
+    memset(ppu->tile_dirty, true, sizeof(ppu->tile_dirty)); // Decoded on first use.
+
+    ppu->   oam_dirty =  true; // Built on the first scan.
+    ppu->sprites_tall = false;
 
     init_pipeline(); 
+    init_tile_decoder();
 
     return ppu;
 }
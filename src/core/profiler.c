@@ -0,0 +1,205 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "core/cart.h"
+#include "core/profiler.h"
+
+typedef struct
+{
+    uint32_t  index;
+    uint64_t cycles;
+
+} ProfileRow;
+
+// Report Helpers
+
+static int compare_rows(const void *a, const void *b)
+{
+    const ProfileRow *x = (const ProfileRow*) a;
+    const ProfileRow *y = (const ProfileRow*) b;
+
+    if (x->cycles != y->cycles)
+        return (x->cycles < y->cycles) ? 1 : -1;
+
+    return (x->index < y->index) ? -1 : 1;
+}
+
+static uint32_t collect_rows(const uint64_t *cycles, uint32_t entries, ProfileRow **rows)
+{
+    uint32_t count = 0;
+
+    for (uint32_t i = 0; i < entries; i++)
+        if (cycles[i] != 0) count++;
+
+    *rows = (ProfileRow*) malloc((count + 1) * sizeof(ProfileRow));
+
+    uint32_t next = 0;
+    for (uint32_t i = 0; i < entries; i++)
+    {
+        if (cycles[i] == 0) continue;
+        (*rows)[next].index  = i;
+        (*rows)[next].cycles = cycles[i];
+        next++;
+    }
+
+    qsort(*rows, count, sizeof(ProfileRow), compare_rows);
+    return count;
+}
+
+static void locate(Profiler *prof, uint32_t index, uint16_t *bank, uint16_t *address)
+{
+    if (index < prof->rom_entries)
+    {
+        *bank    = index / ROM_BANK_SIZE;
+        *address = ((*bank == 0) ? 0x0000 : 0x4000) | (index % ROM_BANK_SIZE);
+        return;
+    }
+
+    index -= prof->rom_entries;
+
+    if (index >= 0x8000) // Banked WRAM
+    {
+        *bank    = (index - 0x8000) / 0x1000;
+        *address = 0xD000 | ((index - 0x8000) % 0x1000);
+        return;
+    }
+
+    *bank    = 0;
+    *address = 0x8000 + index;
+}
+
+static void opcode_name(uint16_t slot, char *buffer, size_t size)
+{
+    if (slot == (PROFILE_OPCODE_SLOTS - 1)) snprintf(buffer, size, "INT");
+    else if (slot >= 256)                   snprintf(buffer, size, "CB %02X", slot - 256);
+    else                                    snprintf(buffer, size, "%02X", slot);
+}
+
+static double percent(uint64_t part, uint64_t whole)
+{
+    return (whole == 0) ? 0.0 : ((100.0 * (double) part) / (double) whole);
+}
+
+// Report Writers
+
+static void write_text_report(Profiler *prof, FILE *file, ProfileRow *pcs, uint32_t pc_count, ProfileRow *ops, uint32_t op_count)
+{
+    char name[8];
+
+    fprintf(file, "Total cycles:  %llu\n",   (unsigned long long) prof->total_cycles);
+    fprintf(file, "Halted cycles: %llu\n\n", (unsigned long long) prof->halted_cycles);
+
+    fprintf(file, "%-10s %14s %8s %12s\n", "BANK:PC", "CYCLES", "%", "RETIRED");
+    for (uint32_t i = 0; (i < pc_count) && (i < PROFILE_REPORT_ROWS); i++)
+    {
+        uint16_t bank, address;
+        locate(prof, pcs[i].index, &bank, &address);
+
+        fprintf(file, "%03X:%04X   %14llu %8.3f %12llu\n",
+            bank, address,
+            (unsigned long long) pcs[i].cycles,
+            percent(pcs[i].cycles, prof->total_cycles),
+            (unsigned long long) prof->pc_hits[pcs[i].index]);
+    }
+
+    fprintf(file, "\n%-10s %14s %8s %12s\n", "OPCODE", "CYCLES", "%", "RETIRED");
+    for (uint32_t i = 0; i < op_count; i++)
+    {
+        opcode_name(ops[i].index, name, sizeof(name));
+
+        fprintf(file, "%-10s %14llu %8.3f %12llu\n",
+            name,
+            (unsigned long long) ops[i].cycles,
+            percent(ops[i].cycles, prof->total_cycles),
+            (unsigned long long) prof->opcode_hits[ops[i].index]);
+    }
+}
+
+static void write_json_report(Profiler *prof, FILE *file, ProfileRow *pcs, uint32_t pc_count, ProfileRow *ops, uint32_t op_count)
+{
+    char name[8];
+
+    fprintf(file, "{\n  \"total_cycles\": %llu,\n  \"halted_cycles\": %llu,\n",
+        (unsigned long long) prof->total_cycles, (unsigned long long) prof->halted_cycles);
+
+    fprintf(file, "  \"locations\": [\n");
+    for (uint32_t i = 0; i < pc_count; i++)
+    {
+        uint16_t bank, address;
+        locate(prof, pcs[i].index, &bank, &address);
+
+        fprintf(file, "    {\"bank\": %u, \"pc\": %u, \"cycles\": %llu, \"retired\": %llu}%s\n",
+            bank, address,
+            (unsigned long long) pcs[i].cycles,
+            (unsigned long long) prof->pc_hits[pcs[i].index],
+            ((i + 1) < pc_count) ? "," : "");
+    }
+    fprintf(file, "  ],\n");
+
+    fprintf(file, "  \"opcodes\": [\n");
+    for (uint32_t i = 0; i < op_count; i++)
+    {
+        opcode_name(ops[i].index, name, sizeof(name));
+
+        fprintf(file, "    {\"opcode\": \"%s\", \"cycles\": %llu, \"retired\": %llu}%s\n",
+            name,
+            (unsigned long long) ops[i].cycles,
+            (unsigned long long) prof->opcode_hits[ops[i].index],
+            ((i + 1) < op_count) ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+}
+
+bool write_profile_report(Profiler *prof, const char *text_path, const char *json_path)
+{
+    FILE *text = fopen(text_path, "w");
+    FILE *json = fopen(json_path, "w");
+
+    if ((text == NULL) || (json == NULL))
+    {
+        if (text != NULL) fclose(text);
+        if (json != NULL) fclose(json);
+        return false;
+    }
+
+    ProfileRow *pcs, *ops;
+    uint32_t pc_count = collect_rows(prof->pc_cycles, prof->entries, &pcs);
+    uint32_t op_count = collect_rows(prof->opcode_cycles, PROFILE_OPCODE_SLOTS, &ops);
+
+    write_text_report(prof, text, pcs, pc_count, ops, op_count);
+    write_json_report(prof, json, pcs, pc_count, ops, op_count);
+
+    free(pcs);
+    free(ops);
+    fclose(text);
+    fclose(json);
+
+    return true;
+}
+
+// Initialization
+
+Profiler *init_profiler(Cartridge *cart)
+{
+    Profiler *prof = (Profiler*) malloc(sizeof(Profiler));
+    memset(prof, 0, sizeof(Profiler));
+
+    uint16_t banks = (cart->rom_bank_quantity > 0) ? cart->rom_bank_quantity : 2;
+
+    prof->rom_entries = (uint32_t) banks * ROM_BANK_SIZE;
+    prof->    entries = prof->rom_entries + PROFILE_RAM_ENTRIES;
+    prof->  pc_cycles = (uint64_t*) calloc(prof->entries, sizeof(uint64_t));
+    prof->    pc_hits = (uint64_t*) calloc(prof->entries, sizeof(uint64_t));
+
+    return prof;
+}
+
+void tidy_profiler(Profiler **prof)
+{
+    free((*prof)->pc_cycles);
+    free((*prof)->pc_hits);
+
+    free(*prof);
+    *prof = NULL;
+}
\ No newline at end of file
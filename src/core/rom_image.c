@@ -0,0 +1,321 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#ifdef _WIN32
+#include <windows.h> // Windows
+#else
+#include <fcntl.h> // Linux
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "core/rom_image.h"
+
+#include "util/common.h"
+
+static RomImage   *registry = NULL;
+static atomic_flag registry_lock = ATOMIC_FLAG_INIT;
+
+static inline void lock_registry()
+{
+    while (atomic_flag_test_and_set_explicit(&registry_lock, memory_order_acquire));
+}
+
+static inline void unlock_registry()
+{
+    atomic_flag_clear_explicit(&registry_lock, memory_order_release);
+}
+
+// File Mapping
+
+#ifdef _WIN32
+
+static bool handle_identity(HANDLE file, FileIdentity *id)
+{
+    BY_HANDLE_FILE_INFORMATION info;
+
+    if (!GetFileInformationByHandle(file, &info))
+        return false;
+
+    id->device = info.dwVolumeSerialNumber;
+    id-> inode = ((uint64_t) info.nFileIndexHigh << 32) | info.nFileIndexLow;
+    id-> mtime = ((uint64_t) info.ftLastWriteTime.dwHighDateTime << 32) | info.ftLastWriteTime.dwLowDateTime;
+    id->  size = ((uint64_t) info.nFileSizeHigh << 32) | info.nFileSizeLow;
+
+    return true;
+}
+
+static bool read_identity(const char *file_path, FileIdentity *id)
+{
+    HANDLE file = CreateFileA(file_path, 0, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, 
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+    if (file == INVALID_HANDLE_VALUE) 
+        return false;
+
+    bool found = handle_identity(file, id);
+    CloseHandle(file);
+
+    return found;
+}
+
+static bool map_file(const char *file_path, RomImage *image)
+{
+    HANDLE file = CreateFileA(file_path, GENERIC_READ, FILE_SHARE_READ, NULL, 
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, NULL);
+
+    if (file == INVALID_HANDLE_VALUE) 
+        return false;
+
+    LARGE_INTEGER size;
+
+    if (!GetFileSizeEx(file, &size) || (size.QuadPart == 0) || !handle_identity(file, &image->id))
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+
+    if (mapping == NULL) 
+        return false;
+
+    void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping); // The view keeps the mapping alive.
+
+    if (view == NULL) 
+        return false;
+
+    image->data = (uint8_t*) view;
+    image->size = (size_t) size.QuadPart;
+
+    return true;
+}
+
+static void unmap_file(RomImage *image)
+{
+    UnmapViewOfFile(image->data);
+}
+
+#else
+
+static void stat_identity(const struct stat *info, FileIdentity *id)
+{
+    id->device = (uint64_t) info->st_dev;
+    id-> inode = (uint64_t) info->st_ino;
+    id-> mtime = ((uint64_t) info->st_mtim.tv_sec * 1000000000ULL) + (uint64_t) info->st_mtim.tv_nsec;
+    id->  size = (uint64_t) info->st_size;
+}
+
+static bool read_identity(const char *file_path, FileIdentity *id)
+{
+    struct stat info;
+
+    if (stat(file_path, &info) != 0)
+        return false;
+
+    stat_identity(&info, id);
+    return true;
+}
+
+static bool map_file(const char *file_path, RomImage *image)
+{
+    int file = open(file_path, O_RDONLY);
+
+    if (file < 0) 
+        return false;
+
+    struct stat info;
+
+    if ((fstat(file, &info) != 0) || (info.st_size == 0))
+    {
+        close(file);
+        return false;
+    }
+
+    stat_identity(&info, &image->id); // From the open file, it may have changed since the lookup.
+
+    void *view = mmap(NULL, (size_t) info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file); // The mapping keeps the file alive.
+
+    if (view == MAP_FAILED) 
+        return false;
+
+    // Whole ROM is hashed right away, bank switching reads it at random after.
+    posix_madvise(view, (size_t) info.st_size, POSIX_MADV_WILLNEED);
+
+    image->data = (uint8_t*) view;
+    image->size = (size_t) info.st_size;
+
+    return true;
+}
+
+static void unmap_file(RomImage *image)
+{
+    munmap(image->data, image->size);
+}
+
+#endif
+
+static uint64_t hash_contents(const uint8_t *data, size_t size)
+{
+    uint64_t hash = 0xCBF29CE484222325ULL;
+
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= data[i];
+        hash *= 0x00000100000001B3ULL;
+    }
+
+    return hash;
+}
+
+static void free_image(RomImage *image)
+{
+    if (image->mapped) 
+        unmap_file(image);
+    else
+        free(image->data);
+
+    free(image->path);
+    free(image);
+}
+
+// Registry
+
+static RomImage *find_image(const char *file_path, const FileIdentity *id) // Caller holds the lock.
+{
+    for (RomImage *image = registry; image != NULL; image = image->next)
+    {
+        bool same = (image->id.device == id->device) && (image->id.inode == id->inode) && 
+        (image->id.mtime == id->mtime) && (image->id.size == id->size) && (strcmp(image->path, file_path) == 0);
+
+        if (same) return image;
+    }
+
+    return NULL;
+}
+
+static RomImage *share_image(const char *file_path, const FileIdentity *id)
+{
+    lock_registry();
+
+    RomImage *shared = find_image(file_path, id);
+
+    if (shared != NULL) 
+        shared->references++;
+
+    unlock_registry();
+
+    return shared;
+}
+
+RomImage *acquire_rom_image(const char *file_path)
+{
+    FileIdentity id;
+
+    if (read_identity(file_path, &id))
+    {
+        RomImage *shared = share_image(file_path, &id);
+        if (shared != NULL) return shared; // Unchanged since it was mapped.
+    }
+
+    RomImage *image = (RomImage*) malloc(sizeof(RomImage));
+    memset(image, 0, sizeof(RomImage));
+
+    if (!map_file(file_path, image))
+    {
+        perror("Unable to map ROM file!");
+        free(image);
+        return NULL;
+    }
+
+    image->      path = (char*) malloc(strlen(file_path) + 1);
+    image->      hash = hash_contents(image->data, image->size);
+    image->    mapped = true;
+    image->references = 1;
+    strcpy(image->path, file_path);
+
+    lock_registry();
+
+    RomImage *shared = find_image(image->path, &image->id); // Another thread may have mapped it meanwhile.
+
+    if (shared != NULL)
+    {
+        shared->references++;
+    }
+    else
+    {
+        image->next = registry;
+        registry    = image;
+    }
+
+    unlock_registry();
+
+    if (shared == NULL) 
+        return image;
+
+    free_image(image);
+    return shared;
+}
+
+/*
+    Headers that declare more banks than the file holds get a private
+    copy padded with open bus, so bank reads never run off the mapping.
+*/
+RomImage *pad_rom_image(RomImage *image, size_t size)
+{
+    if (size <= image->size) 
+        return image;
+
+    RomImage *padded = (RomImage*) malloc(sizeof(RomImage));
+    memset(padded, 0, sizeof(RomImage));
+
+    padded->      data = (uint8_t*) malloc(size);
+    padded->      size = size;
+    padded->      hash = image->hash;
+    padded->        id = image->id;
+    padded->      path = (char*) malloc(strlen(image->path) + 1);
+    padded->    mapped = false;
+    padded->references = 1;
+    strcpy(padded->path, image->path);
+
+    memcpy(padded->data, image->data, image->size);
+    memset(padded->data + image->size, OPEN_BUS, size - image->size);
+
+    release_rom_image(image);
+
+    return padded;
+}
+
+void release_rom_image(RomImage *image)
+{
+    if (image == NULL) return;
+
+    lock_registry();
+
+    bool last = (--image->references == 0);
+
+    if (last)
+    {
+        RomImage **link = &registry;
+
+        while ((*link != NULL) && (*link != image))
+            link = &(*link)->next;
+
+        if (*link != NULL) 
+            *link = image->next; // Padded copies were never registered.
+    }
+
+    unlock_registry();
+
+    if (last) free_image(image);
+}
\ No newline at end of file
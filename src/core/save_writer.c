@@ -0,0 +1,199 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h> // Windows
+#include <io.h>
+#else
+#include <fcntl.h> // Linux
+#include <unistd.h>
+#endif
+
+#include "core/cart.h"
+#include "core/save_writer.h"
+
+#include "util/common.h"
+
+#define TEMP_SUFFIX ".tmp"
+
+static inline void lock_writer(SaveWriter *writer)
+{
+    while (atomic_flag_test_and_set_explicit(&writer->lock, memory_order_acquire));
+}
+
+static inline void unlock_writer(SaveWriter *writer)
+{
+    atomic_flag_clear_explicit(&writer->lock, memory_order_release);
+}
+
+// File Replacement
+
+#ifdef _WIN32
+
+static bool sync_file(FILE *file)
+{
+    return (_commit(_fileno(file)) == 0);
+}
+
+static bool replace_file(const char *temp, const char *path)
+{
+    return MoveFileExA(temp, path, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+}
+
+#else
+
+static bool sync_file(FILE *file)
+{
+    return (fsync(fileno(file)) == 0);
+}
+
+static void sync_parent(const char *path) // Makes the rename itself durable.
+{
+    char directory[MAX_FILE_PATH];
+    snprintf(directory, sizeof(directory), "%s", path);
+
+    char *slash = strrchr(directory, '/');
+    if (slash == NULL) return;
+    *slash = '\0';
+
+    int handle = open(directory, O_RDONLY);
+    if (handle < 0) return;
+
+    fsync(handle);
+    close(handle);
+}
+
+static bool replace_file(const char *temp, const char *path)
+{
+    if (rename(temp, path) != 0) 
+        return false;
+
+    sync_parent(path);
+    return true;
+}
+
+#endif
+
+static bool write_file(SaveWriter *writer, const uint8_t *image)
+{
+    FILE *file = fopen(writer->temp, "wb");
+
+    if (file == NULL) 
+        return false;
+
+    bool written = (fwrite(image, 1, writer->size, file) == writer->size);
+    written = written && (fflush(file) == 0) && sync_file(file);
+
+    if ((fclose(file) != 0) || !written)
+    {
+        remove(writer->temp);
+        return false;
+    }
+
+    return replace_file(writer->temp, writer->path);
+}
+
+// Snapshots
+
+/*
+    Emulation thread only. Dirty bits are cleared as their pages are
+    staged, the tail is small enough to be copied every time.
+*/
+void stage_save_pages(SaveWriter *writer, const uint8_t *ram, uint32_t *dirty_pages, const void *tail, size_t tail_size)
+{
+    uint32_t pages = (uint32_t) (writer->ram_size >> SAVE_PAGE_SHIFT);
+
+    lock_writer(writer);
+
+    for (uint32_t page = 0; page < pages; page++)
+    {
+        uint32_t *word = &dirty_pages[page >> 5];
+        uint32_t   bit = (uint32_t) 1 << (page & 31);
+
+        if ((*word & bit) == 0) continue;
+        *word &= ~bit;
+
+        size_t offset = (size_t) page << SAVE_PAGE_SHIFT;
+        memcpy(&writer->staged[offset], &ram[offset], SAVE_PAGE_SIZE);
+    }
+
+    memcpy(&writer->staged[writer->ram_size], tail, tail_size);
+    atomic_fetch_add_explicit(&writer->staged_count, 1, memory_order_relaxed);
+
+    unlock_writer(writer);
+}
+
+/*
+    One flushing thread at a time. A failed write leaves the snapshot 
+    pending, so the next flush retries it.
+*/
+bool flush_save_writer(SaveWriter *writer)
+{
+    uint32_t count = atomic_load_explicit(&writer->staged_count, memory_order_relaxed);
+
+    if (count == writer->flushed_count) 
+        return false;
+
+    lock_writer(writer);
+    memcpy(writer->flushing, writer->staged, writer->size);
+    count = atomic_load_explicit(&writer->staged_count, memory_order_relaxed);
+    unlock_writer(writer);
+
+    if (!write_file(writer, writer->flushing))
+    {
+        fprintf(stderr, "Unable to write %s\n", writer->path);
+        return false;
+    }
+
+    writer->flushed_count = count;
+    return true;
+}
+
+// Initialization
+
+SaveWriter *init_save_writer(const char *path, const uint8_t *ram, size_t ram_size, const void *tail, size_t tail_size)
+{
+    SaveWriter *writer = (SaveWriter*) malloc(sizeof(SaveWriter));
+
+    writer->    path = (char*) malloc(strlen(path) + 1);
+    writer->    temp = (char*) malloc(strlen(path) + sizeof(TEMP_SUFFIX));
+    writer->    size = ram_size + tail_size;
+    writer->ram_size = ram_size;
+    writer->  staged = (uint8_t*) malloc(writer->size);
+    writer->flushing = (uint8_t*) malloc(writer->size);
+
+    if (!writer->path || !writer->temp || !writer->staged || !writer->flushing)
+    {
+        fprintf(stderr, "Failed to allocate save writer\n");
+        exit(EXIT_FAILURE);
+    }
+
+    strcpy(writer->path, path);
+    strcpy(writer->temp, path);
+    strcat(writer->temp, TEMP_SUFFIX);
+
+    memcpy(writer->staged, ram, ram_size); // Matches the file just loaded.
+    memcpy(&writer->staged[ram_size], tail, tail_size);
+
+    atomic_flag_clear(&writer->lock);
+    atomic_store(&writer->staged_count, 0);
+    writer->flushed_count = 0;
+
+    return writer;
+}
+
+void tidy_save_writer(SaveWriter **writer)
+{
+    free((*writer)->path);
+    free((*writer)->temp);
+    free((*writer)->staged);
+    free((*writer)->flushing);
+
+    free(*writer);
+    *writer = NULL;
+}
\ No newline at end of file
@@ -0,0 +1,163 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "core/emulator.h"
+#include "core/mmu.h"
+#include "core/timer.h"
+#include "core/ppu.h"
+#include "core/scheduler.h"
+
+// Heap Maintenance
+
+static inline bool precedes(Event *a, Event *b)
+{
+    if (a->timestamp != b->timestamp)
+        return (a->timestamp < b->timestamp);
+
+    return (a->type < b->type);
+}
+
+static inline void swap_events(Scheduler *sched, uint8_t i, uint8_t j)
+{
+    Event temp     = sched->heap[i];
+    sched->heap[i] = sched->heap[j];
+    sched->heap[j] = temp;
+
+    sched->slot[sched->heap[i].type] = i;
+    sched->slot[sched->heap[j].type] = j;
+}
+
+static void sift_up(Scheduler *sched, uint8_t index)
+{
+    while (index > 0)
+    {
+        uint8_t parent = (index - 1) / 2;
+        if (!precedes(&sched->heap[index], &sched->heap[parent])) break;
+        swap_events(sched, index, parent);
+        index = parent;
+    }
+}
+
+static void sift_down(Scheduler *sched, uint8_t index)
+{
+    while (true)
+    {
+        uint8_t smallest = index;
+        uint8_t    left  = (2 * index) + 1;
+        uint8_t    right = (2 * index) + 2;
+
+        if ((left  < sched->size) && precedes(&sched->heap[left],  &sched->heap[smallest])) smallest = left;
+        if ((right < sched->size) && precedes(&sched->heap[right], &sched->heap[smallest])) smallest = right;
+
+        if (smallest == index) break;
+        swap_events(sched, index, smallest);
+        index = smallest;
+    }
+}
+
+static inline void sync_next(Scheduler *sched)
+{
+    sched->next = (sched->size > 0) ? sched->heap[0].timestamp : NO_EVENT;
+}
+
+static void remove_at(Scheduler *sched, uint8_t index)
+{
+    EventType type = sched->heap[index].type;
+
+    sched->size--;
+    if (index != sched->size)
+    {
+        swap_events(sched, index, sched->size);
+        EventType moved = sched->heap[index].type;
+        sift_up(sched, index);
+        sift_down(sched, sched->slot[moved]);
+    }
+
+    sched->slot[type] = -1;
+}
+
+// Scheduling API
+
+void schedule_event(Scheduler *sched, EventType type, uint64_t delay)
+{
+    if (sched->slot[type] >= 0)
+        remove_at(sched, sched->slot[type]);
+
+    uint8_t index = sched->size++;
+    sched->heap[index].timestamp = sched->cycle + delay;
+    sched->heap[index].type      = type;
+    sched->slot[type]            = index;
+
+    sift_up(sched, index);
+    sync_next(sched);
+}
+
+/*
+    Machine events land on the next machine cycle boundary, which is
+    however many dots remain on the timer's cycle divider.
+*/
+void schedule_machine_event(Scheduler *sched, EventType type)
+{
+    schedule_event(sched, type, sched->timer->dot);
+}
+
+void cancel_event(Scheduler *sched, EventType type)
+{
+    if (sched->slot[type] < 0) return;
+
+    remove_at(sched, sched->slot[type]);
+    sync_next(sched);
+}
+
+bool event_pending(Scheduler *sched, EventType type)
+{
+    return (sched->slot[type] >= 0);
+}
+
+// Dispatch
+
+void dispatch_events(Scheduler *sched)
+{
+    while ((sched->size > 0) && (sched->heap[0].timestamp <= sched->cycle))
+    {
+        EventType type = sched->heap[0].type;
+        remove_at(sched, 0);
+
+        switch(type)
+        {
+            case PPU_EVENT:  ppu_event(sched->ppu);    break;
+            case HDMA_EVENT: hdma_event(sched->mem);   break;
+            case DMA_EVENT:  dma_event(sched->mem);    break;
+            case TIMA_EVENT: tima_event(sched->timer); break;
+            default:                                   break;
+        }
+    }
+
+    sync_next(sched);
+}
+
+// Linking and Initialization
+
+void link_scheduler(Scheduler *sched, GbcEmu *emu)
+{
+    sched->  mem = emu->mem;
+    sched->timer = emu->timer;
+    sched->  ppu = emu->ppu;
+}
+
+Scheduler *init_scheduler()
+{
+    Scheduler *sched = (Scheduler*) malloc(sizeof(Scheduler));
+    memset(sched, 0, sizeof(Scheduler));
+
+    sched->next = NO_EVENT;
+    memset(sched->slot, -1, sizeof(sched->slot));
+
+    return sched;
+}
+
+void tidy_scheduler(Scheduler **sched)
+{
+    free(*sched);
+    *sched = NULL;
+}
\ No newline at end of file
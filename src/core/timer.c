@@ -7,6 +7,7 @@
 #include "core/apu.h"
 #include "core/ppu.h"
 #include "core/timer.h"
+#include "core/scheduler.h"
 
 #include "util/common.h"
 
@@ -71,6 +72,12 @@ static inline void check_tima_overflow(EmuTimer *timer)
     }
 }
 
+static inline void start_tima_overflow(EmuTimer *timer, TimaOverflowState state)
+{
+    timer->tofs = state;
+    schedule_machine_event(timer->sched, TIMA_EVENT);
+}
+
 static inline void check_apu_event(EmuTimer *timer, bool curr_sys_bit)
 {
     timer->prev_sys_bit = curr_sys_bit;
@@ -111,7 +118,7 @@ static inline bool inc_sys(EmuTimer *timer)
 static void clear_sys(EmuTimer *timer)
 {
    bool tima_overflow = write_sys(timer, 0);
-   if (tima_overflow) timer->tofs = CYCLE_B;
+   if (tima_overflow) start_tima_overflow(timer, CYCLE_B);
 }
 
 static void write_tac(EmuTimer *timer, uint8_t value)
@@ -128,7 +135,7 @@ static void write_tac(EmuTimer *timer, uint8_t value)
         if (!curr_enable || !curr_sys_bit)
         {
             bool tima_overflow = inc_tima(timer);
-            if (tima_overflow) timer->tofs = CYCLE_B;    
+            if (tima_overflow) start_tima_overflow(timer, CYCLE_B);
         }
     }
 }
@@ -163,65 +170,232 @@ void write_timer_register(EmuTimer *timer, uint16_t address, uint8_t value)
     }
 }
 
-// Drivers
+// Events
 
-bool system_clock_pulse(EmuTimer *timer)
+void tima_event(EmuTimer *timer)
 {
-    static uint8_t dots = 4;
+    check_tima_overflow(timer);
 
-    bool frame_ready = false;
+    if (timer->tofs == CYCLE_B) 
+        (*timer->tima) = (*timer->tma);
 
-    check_hdma_transfer(timer->mem);
-    apu_dot(timer->apu);
-    frame_ready = ppu_dot(timer->ppu);
+    if (timer->tofs != NOT_OVERFLOWING)
+        schedule_machine_event(timer->sched, TIMA_EVENT);
+}
 
-    dots--; // Cycle Divider
-    if (dots != 0) return frame_ready;
-    dots = timer->cpu->speed_enabled ? 2 : 4;
+// HALT Fast-Forward
 
-    // Machine Cycle Occurs
+/*
+    While the CPU is halted nothing reads DIV, so the machine cycles up to
+    the next falling edge that drives TIMA or the APU frame sequencer can
+    be absorbed and settled in one step. PPU and joypad interrupts are 
+    caught by the IF & IE check, which wakes the CPU on the same cycle 
+    as the regular path does.
 
-    check_dma_transfer(timer->mem);
-    check_tima_overflow(timer);
+    The same goes for the idle cycles left behind by instruction and block
+    execution: the code has already run, so until the CPU is back in step
+    there is nothing on the bus either.
+*/
+static inline uint16_t cycles_to_fall(EmuTimer *timer, uint8_t bit)
+{
+    uint16_t period = (uint16_t) (1 << (bit + 1));
+    return period - (timer->sys & (period - 1));
+}
 
-    if (timer->tofs == CYCLE_B) 
-        (*timer->tima) = (*timer->tma);
+static uint16_t halt_horizon(EmuTimer *timer)
+{
+    uint16_t next = cycles_to_fall(timer, timer->cpu->speed_enabled ? 11 : 10);
 
-    if (!timer->mem->hdma.bytes_transferring)
-        machine_cycle(timer->cpu);
+    if (tac_enabled(timer))
+    {
+        uint16_t tima_next = cycles_to_fall(timer, sys_shift_table[(*timer->tac) & LOWER_2_MASK]);
+        if (tima_next < next) next = tima_next;
+    }
 
-    if (inc_sys(timer)) 
-        timer->tofs = PRE_CYCLE_A;
+    return next - 1; // The edge itself runs through the regular path.
+}
 
-    return frame_ready;
+static void settle_halt(EmuTimer *timer)
+{
+    if (timer->halt_skipped == 0) return;
+
+    timer->sys = (timer->sys + timer->halt_skipped) & LOWER_14_MASK;
+    sync_div(timer);
+
+    timer->prev_sys_bit = get_current_sys_bit(timer); // Only rising edges were crossed.
+    timer->prev_apu_bit = get_current_apu_bit(timer);
+
+    timer->halt_skipped = 0;
+    timer->halt_horizon = 0;
 }
 
-bool machine_clock_pulse(EmuTimer *timer)
+static uint16_t absorb_room(EmuTimer *timer, bool *catching_up) // Machine cycles that can be absorbed from the next one.
 {
-    static uint8_t dots = 0; 
+    CPU *cpu = timer->cpu;
 
-    bool frame_ready = false;
+    bool dormant = cpu->running && cpu->halted && 
+    (((*cpu->reg.IFR) & (*cpu->reg.IER) & LOWER_5_MASK) == 0);
 
-    dots = timer->cpu->speed_enabled ? 2 : 4;
+    *catching_up = !dormant && !timer->mem->hdma.bytes_transferring && idle_cycle_ready(cpu);
 
-    check_dma_transfer(timer->mem); // DMA Transfer
-    check_tima_overflow(timer);
+    if (!dormant && !(*catching_up)) return 0;
+
+    if (timer->halt_skipped == 0) 
+        timer->halt_horizon = halt_horizon(timer);
+
+    if (timer->halt_skipped >= timer->halt_horizon) return 0;
 
-    for (int i = 0; i < dots; i++)
+    uint16_t room = timer->halt_horizon - timer->halt_skipped;
+    return (*catching_up && (cpu->idle_cycles < room)) ? cpu->idle_cycles : room;
+}
+
+static void absorb_cycles(EmuTimer *timer, uint16_t cycles, bool catching_up)
+{
+    if (catching_up) timer->cpu->idle_cycles -= cycles; // In place of machine_cycle.
+
+    timer->halt_skipped += cycles;
+}
+
+static bool absorb_halt_cycle(EmuTimer *timer)
+{
+    bool catching_up;
+
+    if (absorb_room(timer, &catching_up) > 0)
     {
-        check_hdma_transfer(timer->mem);
-        apu_dot(timer->apu);
-        frame_ready |= ppu_dot(timer->ppu);
+        absorb_cycles(timer, 1, catching_up);
+        return true;
     }
 
-    if (timer->tofs == CYCLE_B) 
-        (*timer->tima) = (*timer->tma);
+    settle_halt(timer);
+    return false;
+}
+
+/*
+    Machine cycles ahead of the current one that the CPU can run through 
+    without missing anything: no event is due and no timer edge is crossed
+    before an instruction starting that far ahead, so no interrupt can be
+    raised and nothing the CPU reads without syncing changes.
+*/
+uint16_t quiet_cycles(EmuTimer *timer)
+{
+    Scheduler *sched = timer->sched;
+    uint32_t  period = timer->cpu->speed_enabled ? 2 : 4;
+    uint16_t   quiet = halt_horizon(timer);
+
+    if (sched->next != NO_EVENT)
+    {
+        uint64_t until = (sched->next - sched->cycle - 1) / period;
+        if (until < quiet) quiet = (uint16_t) until;
+    }
+
+    return quiet;
+}
+
+// Drivers
+
+/*
+    Moves the clock forward by up to the dots left before the next machine
+    cycle. The APU runs the span in one go and everything else is an event
+    dispatched on its own dot: PPU mode changes, DMA, HDMA and TIMA
+    overflow. timer->dot is kept right for the events that read it.
+*/
+static bool advance_clock(EmuTimer *timer, uint32_t dots)
+{
+    Scheduler *sched = timer->sched;
+
+    uint64_t boundary = sched->cycle + timer->dot; // Next machine cycle.
+    uint64_t   target = sched->cycle + dots;
+    uint32_t   period = timer->cpu->speed_enabled ? 2 : 4;
+
+    apu_advance(timer->apu, dots);
+
+    while (sched->next <= target)
+    {
+        sched->cycle = sched->next;
+        timer->  dot = (sched->cycle == boundary) ? period : (uint32_t) (boundary - sched->cycle);
+        dispatch_events(sched);
+    }
+
+    sched->cycle = target;
+    timer->  dot = (target == boundary) ? period : (uint32_t) (boundary - target);
+
+    bool frame_ready = timer->ppu->frame_ready;
+    timer->ppu->frame_ready = false;
+
+    if (target != boundary) return frame_ready;
+
+    // Machine Cycle Occurs
+
+    if (absorb_halt_cycle(timer)) return frame_ready;
 
     if (!timer->mem->hdma.bytes_transferring)
         machine_cycle(timer->cpu);
 
     if (inc_sys(timer)) 
-        timer->tofs = PRE_CYCLE_A;
+        start_tima_overflow(timer, PRE_CYCLE_A);
+
+    return frame_ready;
+}
+
+bool system_clock_pulse(EmuTimer *timer) // A single dot.
+{
+    return advance_clock(timer, 1);
+}
+
+bool machine_clock_pulse(EmuTimer *timer) // Every dot up to and including the next machine cycle.
+{
+    return advance_clock(timer, timer->dot);
+}
+
+/*
+    Moves straight over machine cycles that would all be absorbed, as long
+    as no event falls due and the end of the span is not reached: the APU 
+    runs the dots in one go and SYS is owed the cycles as usual.
+*/
+static void skip_absorbed_cycles(EmuTimer *timer, uint64_t end)
+{
+    Scheduler *sched = timer->sched;
+
+    uint64_t  first = sched->cycle + timer->dot;
+    uint64_t  limit = (sched->next < end) ? sched->next : end;
+    uint32_t period = timer->cpu->speed_enabled ? 2 : 4;
+
+    if (limit <= first) return;
+
+    bool  catching_up;
+    uint64_t  cycles = ((limit - first - 1) / period) + 1; // Boundaries before the limit.
+    uint16_t    room = absorb_room(timer, &catching_up);
+
+    if (room < cycles) cycles = room;
+    if (cycles == 0) return;
+
+    uint32_t dots = timer->dot + ((uint32_t) (cycles - 1) * period);
+
+    apu_advance(timer->apu, dots);
+    sched->cycle += dots;
+    timer->  dot  = period;
+
+    absorb_cycles(timer, (uint16_t) cycles, catching_up);
+}
+
+/*
+    Whole machine cycles until at least "dots" have passed, stopping early
+    on a finished frame. Gives the same result as machine_clock_pulse over 
+    the same cycles, while halted or catching-up stretches cost one step.
+*/
+bool machine_clock_span(EmuTimer *timer, uint32_t dots)
+{
+    Scheduler *sched = timer->sched;
+
+    uint64_t  end = sched->cycle + dots;
+    bool frame_ready = false;
+
+    do
+    {
+        skip_absorbed_cycles(timer, end);
+        frame_ready = machine_clock_pulse(timer);
+
+    } while (!frame_ready && (sched->cycle < end));
 
     return frame_ready;
 }
@@ -240,6 +414,7 @@ void link_timer(EmuTimer *timer, GbcEmu *emu)
     timer-> mem = emu->mem;
     timer-> apu = emu->apu;
     timer-> ppu = emu->ppu;
+    timer->sched = emu->sched;
 
     sync_sys(timer);
 }
@@ -252,6 +427,9 @@ EmuTimer *init_timer()
     timer->prev_apu_bit =               0;
     timer->prev_sys_bit =               0;
     timer->         sys =               0;
+    timer->         dot =               4;
+    timer->halt_skipped =               0;
+    timer->halt_horizon =               0;
     
     return timer;
 }
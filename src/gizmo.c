@@ -8,19 +8,38 @@
 #include "core/ppu.h"
 #include "core/cpu.h"
 #include "core/timer.h"
+#include "core/scheduler.h"
 #include "core/emulator.h"
+#include "core/profiler.h"
 
 #include "gizmo.h"
 
 #include "util/ring_buffer.h"
+#include "util/trace_buffer.h"
 #include "util/audio_filters.h"
 #include "util/common.h"
 
 // Video Constants
 
 #define FRAME_PERIOD 16.74 // 1 / 60 seconds per frame 
+#define TURBO_RENDER_INTERVAL 4 // Frames emulated per frame drawn in turbo.
 #define LCD_BUFFER_SIZE  GBC_HEIGHT * GBC_WIDTH * sizeof(uint32_t)
 
+// Trace Constants
+
+#define TRACE_FILE  "trace.bin"
+#define TRACE_BATCH        4096
+
+// Save Constants
+
+#define AUTOSAVE_FRAMES  300 // Snapshot dirty cartridge RAM every ~5 seconds.
+#define SAVE_POLL_MS     100
+
+// Profile Constants
+
+#define PROFILE_TEXT  "profile.txt"
+#define PROFILE_JSON "profile.json"
+
 // Audio Constants
 
 #define HP_ALPHA    0.998f
@@ -38,6 +57,9 @@ static const int64_t    BASE_FIXED = (int64_t) (BASE_RAW * ((double) FP_ONE));
 static const int64_t MAX_THRESHOLD = (int64_t) (BASE_FIXED * 1.01);
 static const int64_t MIN_THRESHOLD = (int64_t) (BASE_FIXED * 0.99);
 
+static uint64_t sample_counter = 0;
+static uint64_t  sample_thresh = BASE_FIXED;
+
 // SDL Components
 
 static SDL_Window             *window;
@@ -57,6 +79,24 @@ static RingBuffer        ring_buffer = {0};
 static HighPassFilter hpl = {0}, hpr = {0};
 static LowPassFilter  lpl = {0}, lpr = {0};
 
+// Execution Trace
+
+static TraceBuffer trace_buffer;
+static SDL_Thread *trace_thread = NULL;
+static SDL_atomic_t trace_running;
+static FILE          *trace_file;
+static bool       trace_stopping; // Detach posted, not yet taken up by the emulation thread.
+
+// Battery Saves
+
+static SDL_Thread *save_thread = NULL;
+static SDL_atomic_t save_running;
+static SDL_atomic_t save_requested;
+
+#if PROFILE_SUPPORT
+static Profiler *profiler = NULL;
+#endif
+
 static GbcEmu *current_emulator;
 
 // Variable Control
@@ -70,12 +110,14 @@ static void render_sdl_frame(GbcEmu *emu)
 {
     static uint32_t double_buffer[LCD_BUFFER_SIZE] = {0};
 
-    if (!emu->running)
+    if (!emu->running || !last_frame_drawn(emu->ppu))
         return;
 
-    memcpy(double_buffer, render_frame(emu->ppu), LCD_BUFFER_SIZE);
+    size_t pitch = frame_pitch(emu->ppu); // The texture is ARGB8888, the PPU default.
+
+    memcpy(double_buffer, render_frame(emu->ppu), pitch * GBC_HEIGHT);
 
-    SDL_UpdateTexture(framebuffer, NULL, double_buffer, GBC_WIDTH * sizeof(uint32_t));
+    SDL_UpdateTexture(framebuffer, NULL, double_buffer, (int) pitch);
     SDL_RenderClear(renderer);
     SDL_RenderCopy(renderer, framebuffer, NULL, NULL);
     SDL_RenderPresent(renderer);
@@ -214,6 +256,142 @@ static bool init_peripherals()
     return true;
 }
 
+// Execution Trace
+
+static int trace_writer(void *data) // Drains the trace ring to disk off the emulation thread.
+{
+    static TraceRecord batch[TRACE_BATCH];
+
+    while (true)
+    {
+        bool    running = SDL_AtomicGet(&trace_running);
+        uint32_t  count = trace_buffer_drain(&trace_buffer, batch, TRACE_BATCH);
+
+        if (count > 0)
+            fwrite(batch, sizeof(TraceRecord), count, trace_file);
+        else if (!running)
+            break;
+        else
+            SDL_Delay(1);
+    }
+
+    return 0;
+}
+
+static void start_trace(GbcEmu *emu)
+{
+    trace_file = fopen(TRACE_FILE, "wb");
+
+    if (trace_file == NULL)
+    {
+        printf("Unable to open %s!\n", TRACE_FILE);
+        return;
+    }
+
+    reset_trace_buffer(&trace_buffer);
+    SDL_AtomicSet(&trace_running, 1);
+    trace_thread = SDL_CreateThread(trace_writer, "Trace Thread", NULL);
+
+    attach_tracer(emu->cpu, &trace_buffer);
+}
+
+static void stop_trace(GbcEmu *emu)
+{
+    if ((trace_thread == NULL) || trace_stopping) return;
+
+    attach_tracer(emu->cpu, NULL); // Writer keeps draining until finish_trace.
+    trace_stopping = true;
+}
+
+/*
+    The writer only stops once the emulation thread has dropped the buffer,
+    otherwise a record committed after its last drain would be lost. With
+    force set the emulation thread is on its way out and is not waited on.
+*/
+static void finish_trace(GbcEmu *emu, bool force)
+{
+    if (!trace_stopping) return;
+    if (!force && !mode_requests_applied(emu->cpu)) return;
+
+    SDL_AtomicSet(&trace_running, 0);
+    SDL_WaitThread(trace_thread, NULL);
+    trace_thread   = NULL;
+    trace_stopping = false;
+
+    fclose(trace_file);
+    printf("[Trace] Dropped %llu records\n", (unsigned long long) atomic_load(&trace_buffer.dropped));
+}
+
+// Battery Saves
+
+static int save_writer(void *data) // Writes staged snapshots to disk off the emulation thread.
+{
+    Cartridge *cart = (Cartridge*) data;
+
+    while (true)
+    {
+        bool running = SDL_AtomicGet(&save_running);
+
+        flush_cartridge_save(cart);
+
+        if (!running) break;
+        SDL_Delay(SAVE_POLL_MS);
+    }
+
+    return 0;
+}
+
+static void start_save_writer(GbcEmu *emu)
+{
+    SDL_AtomicSet(&save_requested, 0);
+    SDL_AtomicSet(&save_running,   1);
+    save_thread = SDL_CreateThread(save_writer, "Save Thread", emu->cart);
+}
+
+static void stop_save_writer()
+{
+    if (save_thread == NULL) return;
+
+    SDL_AtomicSet(&save_running, 0);
+    SDL_WaitThread(save_thread, NULL); // Flushes any pending snapshot first.
+    save_thread = NULL;
+}
+
+static void check_autosave(GbcEmu *emu) // Emulation thread, once per frame.
+{
+    static uint16_t frames = 0;
+
+    bool requested = (SDL_AtomicSet(&save_requested, 0) != 0);
+
+    frames++;
+    if (!requested && (frames < AUTOSAVE_FRAMES)) return;
+    frames = 0;
+
+    snapshot_cartridge_save(emu->cart, requested);
+}
+
+// Profiling
+
+static void start_profile(GbcEmu *emu)
+{
+#if PROFILE_SUPPORT
+    profiler = init_profiler(emu->cart);
+    attach_profiler(emu->cpu, profiler);
+#endif
+}
+
+static void finish_profile()
+{
+#if PROFILE_SUPPORT
+    if (profiler == NULL) return;
+
+    if (write_profile_report(profiler, PROFILE_TEXT, PROFILE_JSON))
+        printf("[Profile] Written to %s and %s\n", PROFILE_TEXT, PROFILE_JSON);
+
+    tidy_profiler(&profiler);
+#endif
+}
+
 static void tidy_peripherals()
 {
     SDL_PauseAudioDevice(audio_device, true);
@@ -229,16 +407,20 @@ static void tidy_peripherals()
 
 // Emulation Drivers
 
-static void audio_sample_pulse(GbcEmu *emu)
+static uint32_t dots_to_sample() // Spans end on the machine cycle that reaches the next sample.
 {
-    static uint64_t counter = 0;
-    static uint64_t  thresh = BASE_FIXED;
+    if (sample_counter >= sample_thresh) return 1;
 
-    counter += FP_ONE;
-    if (counter < thresh) return;
-    counter -= thresh;
+    return (uint32_t) ((sample_thresh - sample_counter + FP_ONE - 1) / FP_ONE);
+}
+
+static void audio_sample_pulse(GbcEmu *emu, uint32_t dots)
+{
+    sample_counter += FP_ONE * dots;
+    if (sample_counter < sample_thresh) return;
+    sample_counter -= sample_thresh;
     
-    thresh = dynamic_sample_threshold();
+    sample_thresh = dynamic_sample_threshold();
 
     int16_t  left_sample = sample_left_channel(emu->apu);
     int16_t right_sample = sample_right_channel(emu->apu);
@@ -258,11 +440,15 @@ static int emu_thread(void *data)
 
     while(emu->running)
     {
-        bool emu_frame_complete = system_clock_pulse(emu->timer);
-        audio_sample_pulse(emu);
+        uint64_t start = emu->sched->cycle;
+
+        bool emu_frame_complete = machine_clock_span(emu->timer, dots_to_sample());
+        audio_sample_pulse(emu, (uint32_t) (emu->sched->cycle - start));
 
         if (emu_frame_complete) // Emulation Frame Complete? 
         {
+            check_autosave(emu);
+
             SDL_LockMutex(mutex);
 
             while(frame_available)
@@ -277,23 +463,10 @@ static int emu_thread(void *data)
     return 0;
 }
 
-static void check_rtc_clock(GbcEmu *emu)
-{
-    static uint8_t frames = 0;
-
-    frames++;
-    if (frames < 60) return;
-    frames = 0;
-
-    rtc_tick_second(emu->cart);
-}
-
 static void emulate_frame(GbcEmu *emu)
 {
     Uint64 start_time = SDL_GetPerformanceCounter(); // Start Timer
     
-    check_rtc_clock(emu); // Real Time Clock
-
     handle_events(emu);   // Record Input
 
     SDL_LockMutex(mutex); // Frame Sync
@@ -325,6 +498,12 @@ void start_emulator(GbcEmu *emu)
     emu->running = true;
     start_cpu(emu->cpu);
 
+    finish_profile(); // Report on the previous cartridge, if any.
+    start_profile(emu);
+
+    stop_save_writer(); // Previous cartridge, if any.
+    start_save_writer(emu);
+
     // Threading setup
     mutex           = SDL_CreateMutex();
     frame_ready     =  SDL_CreateCond();
@@ -362,6 +541,7 @@ static void choose_file(GbcEmu *emu, bool swapping)
 
     if (file_path && swapping)
     {
+        stop_save_writer();
         swap_cartridge(emu, file_path, file_name);
         start_emulator(emu);
         return;  
@@ -403,7 +583,10 @@ static void handle_button_press(GbcEmu *emu, SDL_Event *event)
         case SDLK_DOWN:      joypad->         DOWN = true; break;
         case SDLK_RIGHT:     joypad->        RIGHT = true; break;
         case SDLK_LEFT:      joypad->         LEFT = true; break;
-        case SDLK_SPACE:     joypad->turbo_enabled = true; break;
+        case SDLK_SPACE:
+            joypad->turbo_enabled = true;
+            set_render_interval(emu->ppu, TURBO_RENDER_INTERVAL);
+            break;
 
         case SDLK_q: // Volume Down
             volume += 1;
@@ -439,14 +622,34 @@ static void handle_button_press(GbcEmu *emu, SDL_Event *event)
             break;
 
         case SDLK_s:
-            save_cartridge(emu->cart);
+            SDL_AtomicSet(&save_requested, 1);
             printf("Saving game!\n");
             break;
 
         case SDLK_t:
-            rtc_tick_hour(emu->cart);
+            rtc_advance(emu->cart, 3600);
             printf("Advancing clock by one hour...");
             break;
+
+        case SDLK_j: // Block Execution
+            enable_block_exec(emu->cpu, !block_exec_requested(emu->cpu));
+            printf("[Block Exec] = %d\n", block_exec_requested(emu->cpu));
+            break;
+
+        case SDLK_k: // Instruction Execution (Per Game)
+            set_exec_mode(emu->cpu, (exec_mode_requested(emu->cpu) == CYCLE_EXEC) ? INSTRUCTION_EXEC : CYCLE_EXEC);
+            printf("[Exec Mode] = %s\n", (exec_mode_requested(emu->cpu) == CYCLE_EXEC) ? "Cycle" : "Instruction");
+            break;
+
+        case SDLK_b: // Scanline Batching
+            enable_line_batching(emu->ppu, !emu->ppu->batch_enabled);
+            printf("[Line Batching] = %d\n", emu->ppu->batch_enabled);
+            break;
+
+        case SDLK_l: // Execution Trace
+            (trace_thread == NULL) ? start_trace(emu) : stop_trace(emu);
+            printf("[Trace] = %d\n", (trace_thread != NULL) && !trace_stopping);
+            break;
     }
 } 
 
@@ -466,7 +669,10 @@ static void handle_button_release(GbcEmu *emu, SDL_Event *event)
         case SDLK_DOWN:      joypad->         DOWN = false; break;
         case SDLK_RIGHT:     joypad->        RIGHT = false; break;
         case SDLK_LEFT:      joypad->         LEFT = false; break;
-        case SDLK_SPACE:     joypad->turbo_enabled = false; break;
+        case SDLK_SPACE:
+            joypad->turbo_enabled = false;
+            set_render_interval(emu->ppu, 1);
+            break;
     }
 }
 
@@ -481,7 +687,11 @@ bool handle_events(GbcEmu *emu)
         {
             case SDL_QUIT:
                 emu->running = false;
+                stop_trace(emu);
+                finish_trace(emu, true);
+                stop_save_writer();
                 ask_to_save(emu);
+                finish_profile();
                 tidy_emulator(&emu);
                 tidy_peripherals();
                 return false;
@@ -498,6 +708,8 @@ bool handle_events(GbcEmu *emu)
         }
     }
     
+    finish_trace(emu, false); // Once a posted detach has been taken up.
+
     if (jirn) 
         request_interrupt(emu->cpu, JOYPAD_INTERRUPT_CODE);
         
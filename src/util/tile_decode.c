@@ -0,0 +1,169 @@
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define X86_KERNELS
+#include <immintrin.h> 
+#endif
+
+#include "util/tile_decode.h"
+
+// Scalar
+
+static void decode_scalar(const uint8_t *data, uint8_t *plain, uint8_t *flipped)
+{
+    for (uint8_t row = 0; row < 8; row++)
+    {
+        uint8_t lsb = data[row * 2];
+        uint8_t msb = data[(row * 2) + 1];
+
+        for (uint8_t i = 0; i < 8; i++)
+        {
+            uint8_t shift = 7 - i;
+            uint8_t color = (((msb >> shift) & 1) << 1) | ((lsb >> shift) & 1);
+
+            plain[(row * 8) + i]         = color;
+            flipped[(row * 8) + (7 - i)] = color;
+        }
+    }
+}
+
+#ifdef X86_KERNELS
+
+// SSE2
+
+/*
+    Two rows per register: each bitplane byte is broadcast across eight 
+    lanes, and every lane tests its own bit. Mirroring is the same test
+    with the bit order reversed.
+*/
+__attribute__((target("sse2")))
+static void decode_sse2(const uint8_t *data, uint8_t *plain, uint8_t *flipped)
+{
+    const __m128i plain_bits = _mm_set1_epi64x((long long) 0x0102040810204080ULL);
+    const __m128i  flip_bits = _mm_set1_epi64x((long long) 0x8040201008040201ULL);
+    const __m128i        one = _mm_set1_epi8(1);
+    const __m128i        two = _mm_set1_epi8(2);
+
+    for (uint8_t row = 0; row < 8; row += 2)
+    {
+        const uint8_t *pair = &data[row * 2];
+
+        __m128i lsb = _mm_set_epi64x((long long) (pair[2] * 0x0101010101010101ULL), (long long) (pair[0] * 0x0101010101010101ULL));
+        __m128i msb = _mm_set_epi64x((long long) (pair[3] * 0x0101010101010101ULL), (long long) (pair[1] * 0x0101010101010101ULL));
+
+        __m128i lo = _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(lsb, plain_bits), plain_bits), one);
+        __m128i hi = _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(msb, plain_bits), plain_bits), two);
+        _mm_storeu_si128((__m128i*) &plain[row * 8], _mm_or_si128(lo, hi));
+
+        lo = _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(lsb, flip_bits), flip_bits), one);
+        hi = _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(msb, flip_bits), flip_bits), two);
+        _mm_storeu_si128((__m128i*) &flipped[row * 8], _mm_or_si128(lo, hi));
+    }
+}
+
+// BMI2
+
+#ifdef __x86_64__
+
+/*
+    PDEP scatters bit n of each plane into byte n, which is the mirrored
+    row on a little-endian host. A byte swap gives the row as stored.
+*/
+__attribute__((target("bmi2")))
+static void decode_bmi2(const uint8_t *data, uint8_t *plain, uint8_t *flipped)
+{
+    for (uint8_t row = 0; row < 8; row++)
+    {
+        uint64_t mirrored = _pdep_u64(data[row * 2],       0x0101010101010101ULL) | 
+                            _pdep_u64(data[(row * 2) + 1], 0x0202020202020202ULL);
+        uint64_t   stored = __builtin_bswap64(mirrored);
+
+        memcpy(&flipped[row * 8], &mirrored, 8);
+        memcpy(&plain[row * 8],   &stored,   8);
+    }
+}
+
+#endif
+#endif
+
+// Selection
+
+TileDecoder decode_tile_rows = decode_scalar;
+
+static bool kernel_supported(DecodeKernel kernel)
+{
+    switch(kernel)
+    {
+        case DECODE_SCALAR: 
+            return true;
+
+#ifdef X86_KERNELS
+        case DECODE_SSE2:   
+            return __builtin_cpu_supports("sse2");
+#ifdef __x86_64__
+        case DECODE_BMI2:   
+            return __builtin_cpu_supports("bmi2");
+#endif
+#endif
+
+        default:
+            return false;
+    }
+}
+
+/*
+    PDEP is microcoded, and far slower than the SSE2 path, on AMD parts 
+    before Zen 3, so BMI2 is only preferred on Intel.
+*/
+DecodeKernel detect_decode_kernel()
+{
+#ifdef X86_KERNELS
+    __builtin_cpu_init();
+
+    if (kernel_supported(DECODE_BMI2) && __builtin_cpu_is("intel")) 
+        return DECODE_BMI2;
+
+    if (kernel_supported(DECODE_SSE2)) 
+        return DECODE_SSE2;
+#endif
+
+    return DECODE_SCALAR;
+}
+
+bool select_decode_kernel(DecodeKernel kernel)
+{
+    if (!kernel_supported(kernel)) 
+        return false;
+
+    switch(kernel)
+    {
+        case DECODE_SCALAR: decode_tile_rows = decode_scalar; break;
+#ifdef X86_KERNELS
+        case DECODE_SSE2:   decode_tile_rows = decode_sse2;   break;
+#ifdef __x86_64__
+        case DECODE_BMI2:   decode_tile_rows = decode_bmi2;   break;
+#endif
+#endif
+        default: break;
+    }
+
+    return true;
+}
+
+const char *decode_kernel_name(DecodeKernel kernel)
+{
+    switch(kernel)
+    {
+        case DECODE_SCALAR: return "scalar";
+        case DECODE_SSE2:   return "sse2";
+        case DECODE_BMI2:   return "bmi2";
+    }
+
+    return "unknown";
+}
+
+void init_tile_decoder()
+{
+    select_decode_kernel(detect_decode_kernel());
+}
\ No newline at end of file
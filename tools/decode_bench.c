@@ -0,0 +1,63 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "util/tile_decode.h"
+
+#define BENCH_TILES  4096
+#define BENCH_PASSES 2000
+
+static uint8_t    tiles[BENCH_TILES][TILE_DATA_BYTES];
+static uint8_t    plain[BENCH_TILES][TILE_PIXELS];
+static uint8_t  flipped[BENCH_TILES][TILE_PIXELS];
+static uint8_t   expect[2][BENCH_TILES][TILE_PIXELS];
+
+static double run_kernel()
+{
+    clock_t start = clock();
+
+    for (int pass = 0; pass < BENCH_PASSES; pass++)
+        for (int i = 0; i < BENCH_TILES; i++)
+            decode_tile_rows(tiles[i], plain[i], flipped[i]);
+
+    double seconds = (double) (clock() - start) / CLOCKS_PER_SEC;
+    return (seconds * 1e9) / ((double) BENCH_PASSES * BENCH_TILES);
+}
+
+int main(int argc, char *argv[])
+{
+    srand(1);
+
+    for (int i = 0; i < BENCH_TILES; i++)
+        for (int j = 0; j < TILE_DATA_BYTES; j++)
+            tiles[i][j] = (uint8_t) rand();
+
+    select_decode_kernel(DECODE_SCALAR);
+    for (int i = 0; i < BENCH_TILES; i++)
+        decode_tile_rows(tiles[i], expect[0][i], expect[1][i]);
+
+    printf("%-8s %12s %8s\n", "KERNEL", "NS/TILE", "CHECK");
+
+    DecodeKernel kernels[] = { DECODE_SCALAR, DECODE_SSE2, DECODE_BMI2 };
+
+    for (int k = 0; k < 3; k++)
+    {
+        if (!select_decode_kernel(kernels[k]))
+        {
+            printf("%-8s %12s %8s\n", decode_kernel_name(kernels[k]), "-", "n/a");
+            continue;
+        }
+
+        double ns = run_kernel();
+        bool   ok = (memcmp(plain, expect[0], sizeof(plain)) == 0) && (memcmp(flipped, expect[1], sizeof(flipped)) == 0);
+
+        printf("%-8s %12.2f %8s\n", decode_kernel_name(kernels[k]), ns, ok ? "ok" : "MISMATCH");
+    }
+
+    printf("Selected at startup: %s\n", decode_kernel_name(detect_decode_kernel()));
+
+    return 0;
+}
\ No newline at end of file
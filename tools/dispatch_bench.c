@@ -0,0 +1,212 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "core/emulator.h"
+#include "core/cpu.h"
+#include "core/timer.h"
+#include "core/ppu.h"
+#include "core/scheduler.h"
+
+#define BENCH_FRAMES   600
+#define BENCH_RUNS       5 // Best run is reported.
+#define BENCH_ROM     "dispatch_bench.gb"
+#define BENCH_SPAN      95 // Dots per 44.1 kHz sample, the frontend's span.
+#define ROM_SIZE      0x8000
+#define FRAME_MS      16.74
+
+/*
+    Runs a register-only loop from a generated ROM-only cartridge in each
+    execution mode, with the LCD off so the CPU and the clock driver are
+    all that is left. Build it with -DTHREADED_DISPATCH=0 and =1 and compare
+    the two. The clock runs in spans of one audio sample, as the frontend
+    does. Block execution chains from one opcode label to the next through
+    a block, instruction mode through the cycles the timer reports quiet;
+    cycle mode returns after every step.
+*/
+static const uint8_t entry[] =
+{
+    0x00,             // $0100 NOP
+    0xC3, 0x50, 0x01, // $0101 JP $0150
+};
+
+static const uint8_t program[] =
+{
+    0xF3,             // $0150 DI
+    0xAF,             // $0151 XOR A
+    0xE0, 0x40,       // $0152 LDH ($40), A
+    0x06, 0x03,       // $0154 LD B, $03
+    0x0E, 0x5A,       // $0156 LD C, $5A
+    0x1E, 0x00,       // $0158 LD E, $00
+    0x3C,             // $015A INC A
+    0x80,             // $015B ADD A, B
+    0xA9,             // $015C XOR C
+    0x57,             // $015D LD D, A
+    0x07,             // $015E RLCA
+    0xCB, 0x11,       // $015F RL C
+    0x1D,             // $0161 DEC E
+    0x20, 0xF6,       // $0162 JR NZ, $015A
+    0x24,             // $0164 INC H
+    0x18, 0xF3,       // $0165 JR $015A
+};
+
+/*
+    Polling loops with the LCD on, each waiting for a register to change
+    and then for it to change back. The idle loop detector should absorb
+    most of their cycles; the ABSORBED column is the share it did.
+*/
+static const uint8_t poll_ly[] =
+{
+    0xF3,             // $0150 DI
+    0xF0, 0x44,       // $0151 LDH A, ($44)
+    0xFE, 0x90,       // $0153 CP $90
+    0x20, 0xFA,       // $0155 JR NZ, $0151
+    0xF0, 0x44,       // $0157 LDH A, ($44)
+    0xFE, 0x90,       // $0159 CP $90
+    0x28, 0xFA,       // $015B JR Z, $0157
+    0x18, 0xF2,       // $015D JR $0151
+};
+
+static const uint8_t poll_stat_and[] =
+{
+    0xF3,             // $0150 DI
+    0xF0, 0x41,       // $0151 LDH A, ($41)
+    0xE6, 0x03,       // $0153 AND $03
+    0xFE, 0x01,       // $0155 CP $01
+    0x20, 0xF8,       // $0157 JR NZ, $0151
+    0xF0, 0x41,       // $0159 LDH A, ($41)
+    0xE6, 0x03,       // $015B AND $03
+    0xFE, 0x01,       // $015D CP $01
+    0x28, 0xF8,       // $015F JR Z, $0159
+    0x18, 0xEE,       // $0161 JR $0151
+};
+
+static const uint8_t poll_stat_bit[] =
+{
+    0xF3,             // $0150 DI
+    0xF0, 0x41,       // $0151 LDH A, ($41)
+    0xCB, 0x47,       // $0153 BIT 0, A
+    0x20, 0xFA,       // $0155 JR NZ, $0151
+    0xF0, 0x41,       // $0157 LDH A, ($41)
+    0xCB, 0x47,       // $0159 BIT 0, A
+    0x28, 0xFA,       // $015B JR Z, $0157
+    0x18, 0xF2,       // $015D JR $0151
+};
+
+static bool write_rom(const uint8_t *code, size_t size)
+{
+    static uint8_t rom[ROM_SIZE];
+
+    memset(rom, 0, ROM_SIZE);
+    memcpy(&rom[0x0100], entry, sizeof(entry));
+    memcpy(&rom[0x0134], "DISPATCH", 8);
+    memcpy(&rom[0x0150], code, size);
+
+    FILE *file = fopen(BENCH_ROM, "wb");
+
+    if (file == NULL)
+        return false;
+
+    bool written = (fwrite(rom, 1, ROM_SIZE, file) == ROM_SIZE);
+    fclose(file);
+
+    return written;
+}
+
+static double run_mode(ExecMode mode, bool block_exec, double *absorbed) // Pulses when measuring absorption.
+{
+    GbcEmu *emu = init_emulator();
+    memset(emu, 0, sizeof(GbcEmu));
+
+    load_cartridge(emu, BENCH_ROM, BENCH_ROM);
+    emu->running = true;
+    start_cpu(emu->cpu);
+    set_exec_mode(emu->cpu, mode);
+    enable_block_exec(emu->cpu, block_exec);
+
+    uint64_t  end = emu->sched->cycle + ((uint64_t) BENCH_FRAMES * DOT_PER_FRAME);
+    uint64_t spun = 0, cycles = 0;
+    clock_t start = clock();
+
+    while (emu->sched->cycle < end) // Frame lengths of emulated time.
+    {
+        if (absorbed == NULL)
+        {
+            machine_clock_span(emu->timer, BENCH_SPAN);
+            continue;
+        }
+
+        machine_clock_pulse(emu->timer);
+
+        spun += (emu->cpu->spin.state == SPIN_ACTIVE);
+        cycles++;
+    }
+
+    double seconds = (double) (clock() - start) / CLOCKS_PER_SEC;
+    tidy_emulator(&emu);
+
+    if (absorbed != NULL) *absorbed = (100.0 * spun) / cycles;
+
+    return (seconds * 1e3) / BENCH_FRAMES;
+}
+
+static double best_run(ExecMode mode, bool block_exec, double *absorbed)
+{
+    double ms = run_mode(mode, block_exec, absorbed);
+
+    for (int run = 1; run < BENCH_RUNS; run++)
+    {
+        double retry = run_mode(mode, block_exec, absorbed);
+        if (retry < ms) ms = retry;
+    }
+
+    return ms;
+}
+
+int main(int argc, char *argv[])
+{
+    if (!write_rom(program, sizeof(program)))
+    {
+        perror("Unable to write bench ROM!");
+        return 1;
+    }
+
+    const char   *names[] = { "cycle", "insn", "block" };
+    const ExecMode modes[] = { CYCLE_EXEC, INSTRUCTION_EXEC, CYCLE_EXEC };
+
+    printf("Dispatch: %s\n", THREADED_DISPATCH ? "threaded" : "function pointers");
+    printf("%-10s %12s %10s\n", "MODE", "MS/FRAME", "SPEED");
+
+    for (int m = 0; m < 3; m++)
+    {
+        double ms = best_run(modes[m], (m == 2), NULL);
+        printf("%-10s %12.3f %9.1fx\n", names[m], ms, FRAME_MS / ms);
+    }
+
+    const char    *polls[] = { "ly/cp", "stat/and", "stat/bit" };
+    const uint8_t *codes[] = { poll_ly, poll_stat_and, poll_stat_bit };
+    const size_t   sizes[] = { sizeof(poll_ly), sizeof(poll_stat_and), sizeof(poll_stat_bit) };
+
+    printf("\n%-10s %12s %10s\n", "POLL", "MS/FRAME", "ABSORBED");
+
+    for (int p = 0; p < 3; p++)
+    {
+        if (!write_rom(codes[p], sizes[p]))
+        {
+            perror("Unable to write bench ROM!");
+            return 1;
+        }
+
+        double absorbed = 0;
+        double       ms = best_run(CYCLE_EXEC, false, &absorbed);
+
+        printf("%-10s %12.3f %9.1f%%\n", polls[p], ms, absorbed);
+    }
+
+    remove(BENCH_ROM);
+
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,198 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "util/circular_queue.h"
+#include "util/pixel_fifo.h"
+
+#define BENCH_LINES   4096
+#define BENCH_PASSES   200
+#define LINE_WIDTH     160
+#define LINE_OBJECTS    10
+
+/*
+    Replays the FIFO traffic of mode 3 for a set of random scanlines: a
+    background row pushed whenever the BG/Win FIFO runs dry, object rows
+    merged as their X position comes up, and one pixel popped from each
+    FIFO per dot. Both implementations fold the popped pixels into a
+    checksum so the comparison also checks they agree.
+*/
+typedef struct
+{
+    uint8_t    scx;
+    uint8_t   rows[LINE_WIDTH / FIFO_ROW + 1][FIFO_ROW];
+    uint8_t   attr[LINE_WIDTH / FIFO_ROW + 1];
+    uint8_t  obj_x[LINE_OBJECTS];
+    uint8_t obj_row[LINE_OBJECTS][FIFO_ROW];
+    uint8_t obj_attr[LINE_OBJECTS];
+
+} BenchLine;
+
+static BenchLine lines[BENCH_LINES];
+
+static int compare_x(const void *a, const void *b)
+{
+    return *(const uint8_t*) a - *(const uint8_t*) b;
+}
+
+static void generate_lines()
+{
+    srand(1);
+
+    for (int l = 0; l < BENCH_LINES; l++)
+    {
+        BenchLine *line = &lines[l];
+        line->scx = (uint8_t) rand();
+
+        for (int t = 0; t <= (LINE_WIDTH / FIFO_ROW); t++)
+        {
+            line->attr[t] = (uint8_t) rand() & PIXEL_ATTR_MASK;
+            for (int i = 0; i < FIFO_ROW; i++) line->rows[t][i] = rand() & 3;
+        }
+
+        for (int o = 0; o < LINE_OBJECTS; o++)
+        {
+            line->   obj_x[o] = (uint8_t) (rand() % (LINE_WIDTH + FIFO_ROW));
+            line->obj_attr[o] = (uint8_t) rand() & PIXEL_ATTR_MASK;
+            for (int i = 0; i < FIFO_ROW; i++) line->obj_row[o][i] = rand() & 3;
+        }
+
+        qsort(line->obj_x, LINE_OBJECTS, 1, compare_x);
+    }
+}
+
+// Generic Queue
+
+static uint64_t run_queue(Queue *bgw, Queue *obj)
+{
+    uint64_t sum = 0;
+
+    for (int l = 0; l < BENCH_LINES; l++)
+    {
+        BenchLine *line = &lines[l];
+        uint8_t tile = 0, next = 0;
+
+        reset_queue(bgw);
+        reset_queue(obj);
+
+        for (int lx = 0; lx < LINE_WIDTH; lx++)
+        {
+            while ((next < LINE_OBJECTS) && ((lx + FIFO_ROW) >= line->obj_x[next]))
+            {
+                GbcPixel pixel = {0};
+                while (obj->size < FIFO_ROW) enqueue_pixel(obj, &pixel);
+
+                for (int i = 0; i < FIFO_ROW; i++)
+                {
+                    GbcPixel *current = dequeue(obj);
+                    pixel.      color = line->obj_row[next][i];
+                    pixel.   priority = (line->obj_attr[next] & 0x80) != 0;
+                    pixel.dmg_palette = (line->obj_attr[next] >> 4) & 1;
+                    pixel.cgb_palette = line->obj_attr[next] & 7;
+                    enqueue_pixel(obj, (current->color == 0) ? &pixel : current);
+                }
+
+                for (int i = 0; i < ((lx + FIFO_ROW) - line->obj_x[next]); i++) dequeue(obj);
+                next++;
+            }
+
+            if (is_empty(bgw))
+            {
+                for (int i = (tile == 0) ? (line->scx % FIFO_ROW) : 0; i < FIFO_ROW; i++)
+                {
+                    GbcPixel pixel = { line->rows[tile][i], 0, line->attr[tile] & 7, (line->attr[tile] & 0x80) != 0 };
+                    enqueue_pixel(bgw, &pixel);
+                }
+                tile++;
+            }
+
+            GbcPixel *b = dequeue(bgw);
+            sum = (sum * 31) + b->color + (b->cgb_palette << 2) + (b->priority << 7);
+
+            if (!is_empty(obj))
+            {
+                GbcPixel *o = dequeue(obj);
+                sum = (sum * 31) + o->color + (o->cgb_palette << 2) + (o->dmg_palette << 4) + (o->priority << 7);
+            }
+        }
+    }
+
+    return sum;
+}
+
+// Inline FIFO
+
+static uint64_t run_fifo(PixelFifo *bgw, PixelFifo *obj)
+{
+    uint64_t sum = 0;
+
+    for (int l = 0; l < BENCH_LINES; l++)
+    {
+        BenchLine *line = &lines[l];
+        uint8_t tile = 0, next = 0;
+
+        reset_pixel_fifo(bgw);
+        reset_pixel_fifo(obj);
+
+        for (int lx = 0; lx < LINE_WIDTH; lx++)
+        {
+            while ((next < LINE_OBJECTS) && ((lx + FIFO_ROW) >= line->obj_x[next]))
+            {
+                merge_pixel_row(obj, line->obj_row[next], line->obj_attr[next]);
+                drop_pixels(obj, (lx + FIFO_ROW) - line->obj_x[next]);
+                next++;
+            }
+
+            if (bgw->size == 0)
+            {
+                push_pixel_row(bgw, line->rows[tile], line->attr[tile]);
+                drop_pixels(bgw, (tile == 0) ? (line->scx % FIFO_ROW) : 0);
+                tile++;
+            }
+
+            uint8_t b = pop_pixel(bgw);
+            sum = (sum * 31) + bgw->color[b] + ((bgw->attr[b] & 7) << 2) + (bgw->attr[b] & 0x80);
+
+            if (obj->size != 0)
+            {
+                uint8_t o = pop_pixel(obj);
+                sum = (sum * 31) + obj->color[o] + ((obj->attr[o] & 7) << 2) + (obj->attr[o] & 0x90);
+            }
+        }
+    }
+
+    return sum;
+}
+
+int main(int argc, char *argv[])
+{
+    generate_lines();
+
+    Queue *bgw_queue = init_queue(2 * FIFO_ROW, PIXEL);
+    Queue *obj_queue = init_queue(FIFO_ROW, PIXEL);
+
+    static PixelFifo bgw_fifo, obj_fifo;
+
+    uint64_t expect = 0, sum = 0;
+
+    clock_t start = clock();
+    for (int pass = 0; pass < BENCH_PASSES; pass++) expect = run_queue(bgw_queue, obj_queue);
+    double queue_ns = ((double) (clock() - start) / CLOCKS_PER_SEC) * 1e9 / ((double) BENCH_PASSES * BENCH_LINES);
+
+    start = clock();
+    for (int pass = 0; pass < BENCH_PASSES; pass++) sum = run_fifo(&bgw_fifo, &obj_fifo);
+    double fifo_ns = ((double) (clock() - start) / CLOCKS_PER_SEC) * 1e9 / ((double) BENCH_PASSES * BENCH_LINES);
+
+    printf("%-8s %12s %8s\n", "FIFO", "NS/LINE", "CHECK");
+    printf("%-8s %12.1f %8s\n", "queue",  queue_ns, "-");
+    printf("%-8s %12.1f %8s\n", "inline", fifo_ns, (sum == expect) ? "ok" : "MISMATCH");
+    printf("Speedup: %.2fx\n", queue_ns / fifo_ns);
+
+    tidy_queue(bgw_queue);
+    tidy_queue(obj_queue);
+
+    return 0;
+}
\ No newline at end of file
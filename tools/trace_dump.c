@@ -0,0 +1,66 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "util/trace_buffer.h"
+#include "util/disassembler.h"
+
+#define DUMP_BATCH 4096
+
+static const char *interrupt_name(uint8_t code)
+{
+    switch(code)
+    {
+        case 0x01: return "VBLANK INTERRUPT";
+        case 0x02: return "LCD INTERRUPT";
+        case 0x04: return "TIMER INTERRUPT";
+        case 0x08: return "SERIAL INTERRUPT";
+        case 0x10: return "JOYPAD INTERRUPT";
+        default:   return "INTERRUPT";
+    }
+}
+
+static void dump_record(TraceRecord *record)
+{
+    bool   prefixed = (record->kind == TRACE_INSTRUCTION) && (record->bytes[0] == 0xCB);
+    const char *word = (record->kind == TRACE_INTERRUPT) ? interrupt_name(record->bytes[0]) : 
+                        prefixed ? cb_opcode_word[record->bytes[1]] : opcode_word[record->bytes[0]];
+
+    printf(
+        "%12llu  %02X:%04X  %02X %02X %02X  %-17s  AF=%02X%02X BC=%02X%02X DE=%02X%02X HL=%02X%02X SP=%04X\n",
+        (unsigned long long) record->cycle,
+        record->bank, record->pc,
+        record->bytes[0], record->bytes[1], record->bytes[2],
+        word,
+        record->A, record->F, record->B, record->C, record->D, record->E, record->H, record->L,
+        record->sp
+    );
+}
+
+int main(int argc, char *argv[])
+{
+    static TraceRecord batch[DUMP_BATCH];
+
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s <trace.bin>\n", argv[0]);
+        return 1;
+    }
+
+    FILE *file = fopen(argv[1], "rb");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Unable to open %s!\n", argv[1]);
+        return 1;
+    }
+
+    size_t count;
+    while ((count = fread(batch, sizeof(TraceRecord), DUMP_BATCH, file)) > 0)
+    {
+        for (size_t i = 0; i < count; i++)
+            dump_record(&batch[i]);
+    }
+
+    fclose(file);
+    return 0;
+}
\ No newline at end of file